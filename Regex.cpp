@@ -1,4 +1,8 @@
 #include <Regex.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <new>
+#include <pthread.h>
 namespace ft
 {
     CustomLongLong operator+(long long lhs, const CustomLongLong &rhs)
@@ -136,22 +140,168 @@ namespace ft
     {
         return error;
     }
+
+    const char* Regex::BacktrackLimitException::what() const throw()
+    {
+        return "Regex: the backtracking stack exceeded its limit";
+    }
     
     Regex::ret_t::ret_t(CustomLongLong min, CustomLongLong max, RegexComponentBase* c):
          min(min), max(max), c(c) {}
 
     Regex::Regex(const std::string &regx, unsigned int flags) : 
-        regex(regx), flags(flags), current(regex.begin()), allowed_repeat(true)
+        regex(regx), flags(flags), current(regex.begin()),
+        dfaBudget(RegexLazyDFA::DefaultBudget),
+        backtrackLimit(RegexBacktracker::DefaultLimit),
+        memoLimit(RegexBacktracker::DefaultMemoLimit), allowed_repeat(true)
     {
         this->root = this->parse();
+        this->program = RegexProgram::compile(this->root, this->inner_groups.size());
+        if (!this->program)
+            throw InvalidRegexException("Regex too large");
+        this->reverseProgram = NULL;
+        if (this->program->anchoredEnd
+            && RegexLazyDFA::eligible(this->program))
+            this->reverseProgram = RegexProgram::compile(this->root, 0, true);
+    }
+
+    // a regex read from a RegexImage, nothing is parsed nor compiled
+    Regex::Regex(const std::string &regx, unsigned int flags, RegexProgram *program,
+        RegexProgram *reverseProgram) :
+        regex(regx), flags(flags), current(regex.begin()), root(NULL),
+        program(program), reverseProgram(reverseProgram),
+        dfaBudget(RegexLazyDFA::DefaultBudget),
+        backtrackLimit(RegexBacktracker::DefaultLimit),
+        memoLimit(RegexBacktracker::DefaultMemoLimit), allowed_repeat(true) {}
+
+    // Start scratch_t
+
+    Regex::scratch_t::scratch_t() : dfa(NULL), reverseDFA(NULL), budget(0),
+        backtracker(NULL), limit(0), memoLimit(0), pike(NULL) {}
+
+    Regex::scratch_t::~scratch_t()
+    {
+        delete this->dfa;
+        delete this->reverseDFA;
+        delete this->backtracker;
+        delete this->pike;
+    }
+
+    Regex::pool_t::pool_t()
+    {
+        if (pthread_mutex_init(&this->lock, NULL))
+            throw std::runtime_error("Regex: pthread_mutex_init() failed");
+    }
+
+    Regex::pool_t::~pool_t()
+    {
+        this->clear();
+        pthread_mutex_destroy(&this->lock);
     }
 
+    // the lock is only held to pop or push a pointer, the scratch is
+    // built and used without it
+    Regex::scratch_t    *Regex::pool_t::take()
+    {
+        scratch_t   *s = NULL;
+
+        pthread_mutex_lock(&this->lock);
+        if (!this->idle.empty())
+        {
+            s = this->idle.back();
+            this->idle.pop_back();
+        }
+        pthread_mutex_unlock(&this->lock);
+        return s ? s : new scratch_t();
+    }
+
+    void    Regex::pool_t::give(scratch_t *s)
+    {
+        pthread_mutex_lock(&this->lock);
+        try
+        {
+            this->idle.push_back(s);
+        }
+        catch (std::bad_alloc const&)
+        {
+            delete s;
+        }
+        pthread_mutex_unlock(&this->lock);
+    }
+
+    // must not be called while another thread is matching
+    void    Regex::pool_t::clear()
+    {
+        for (size_t i = 0; i < this->idle.size(); i++)
+            delete this->idle[i];
+        this->idle.clear();
+    }
+
+    Regex::lease_t::lease_t(pool_t &pool) : pool(pool), scratch(*pool.take()) {}
+
+    Regex::lease_t::lease_t(Regex const& regex) : pool(regex.pool),
+        scratch(*regex.pool.take())
+    {
+        try
+        {
+            regex.prepare(this->scratch);
+        }
+        catch (...)
+        {
+            this->pool.give(&this->scratch);
+            throw;
+        }
+    }
+
+    Regex::lease_t::~lease_t()
+    {
+        this->pool.give(&this->scratch);
+    }
+
+    // the engines are built the first time the scratch runs the regex
+    void    Regex::prepare(scratch_t &scratch) const
+    {
+        scratch_t   *s = &scratch;
+
+        // a budget of 0 disables the DFAs
+        if (!this->dfaBudget)
+        {
+            delete s->dfa;
+            delete s->reverseDFA;
+            s->dfa = NULL;
+            s->reverseDFA = NULL;
+        }
+        if (!s->dfa && this->dfaBudget && RegexLazyDFA::eligible(this->program))
+            s->dfa = new RegexLazyDFA(*this->program, this->dfaBudget);
+        if (!s->reverseDFA && this->dfaBudget && this->reverseProgram)
+            s->reverseDFA = new RegexLazyDFA(*this->reverseProgram, this->dfaBudget);
+        if (s->dfa && s->budget != this->dfaBudget)
+            s->dfa->setBudget(this->dfaBudget);
+        if (s->reverseDFA && s->budget != this->dfaBudget)
+            s->reverseDFA->setBudget(this->dfaBudget);
+        s->budget = this->dfaBudget;
+        if (!s->backtracker)
+            s->backtracker = new RegexBacktracker(*this->program, this->backtrackLimit,
+                this->memoLimit);
+        if (s->backtracker && s->limit != this->backtrackLimit)
+            s->backtracker->setLimit(this->backtrackLimit);
+        s->limit = this->backtrackLimit;
+        if (s->backtracker && s->memoLimit != this->memoLimit)
+            s->backtracker->setMemoLimit(this->memoLimit);
+        s->memoLimit = this->memoLimit;
+        if (!s->pike)
+            s->pike = new RegexPikeVM(*this->program, NULL, NULL);
+    }
+
+    // END scratch_t
+
     RegexComponentBase*
     Regex::parse()
     {
 
-        RegexStartOfGroup *group = new RegexStartOfGroup();
-        RegexEndOfGroup *end = new RegexEndOfGroup(group);
+        RegexStartOfGroup *group =
+            new (this->arena) RegexStartOfGroup(this->arena, inner_groups.size());
+        RegexEndOfGroup *end = new (this->arena) RegexEndOfGroup(this->arena, group);
         inner_groups.push_back(group);
         ret_t   res = expr();
         res = concat(ret_t(0, 0, group), concat(res, ret_t(0, 0, end)));
@@ -161,75 +311,466 @@ namespace ft
         return res.c;
     }
 
-    bool Regex::match(std::string const& str, result_t &r) 
+    bool Regex::match(std::string const& str, result_t &r) const
+    {
+        return this->match(str.data(), str.size(), r);
+    }
+
+    bool    Regex::match(const char *str, result_t &r) const
+    {
+        return this->match(str, std::strlen(str), r);
+    }
+
+    bool    Regex::match(const char *str, size_t len, result_t &r) const
+    {
+        if (!len || !this->program->mayMatch(str, str + len))
+            return false;
+
+        lease_t     lease(*this);
+
+        if (this->search(lease.scratch, str, str + len, str, lease.scratch.slots) != Match)
+            return false;
+        this->fillResult(lease.scratch.slots, r);
+        return true;
+    }
+
+    bool    Regex::match(const char *str, size_t len, match_t &m) const
+    {
+        return this->tryMatch(str, len, m, limit_t()) == Match;
+    }
+
+    int     Regex::tryMatch(const char *str, size_t len, match_t &m,
+        limit_t const& limit) const
     {
-        return this->match(str.c_str(), r);
+        RegexBudget budget(limit.steps,
+            limit.deadline.tv_sec || limit.deadline.tv_usec ? &limit.deadline : NULL);
+
+        m.data = str;
+        int res = this->search(str, str + len, str, m.slots,
+            limit.steps || budget.timed ? &budget : NULL);
+        // drop the slots of the loops, the capacity is kept
+        if (res == Match)
+            m.slots.resize(2 * this->program->groups);
+        return res;
     }
 
-    bool    Regex::match(const char *str, result_t &r)
+    // leftmost-first match starting in [from, endOfStr), slots receives
+    // the bounds of the groups. The bytes before from are only looked at
+    // by ^, \b and the look-behinds. Only the backtracking matchers use
+    // the budget, the DFA and the Pike VM run in linear time
+    int     Regex::search(const char *startOfStr, const char *endOfStr,
+        const char *from, std::vector<const char *> &slots, RegexBudget *budget) const
     {
-        RegexEnd end;
-        MatchInfo info;
-        info.startOfStr = str;
-        info.endOfStr = str + std::strlen(str);
-        info.flags = flags;
-        Functor fn(&end, str, 0, &info, NULL);
-        for (size_t i = 0; str[i]; i++)
+        if (from >= endOfStr)
+            return NoMatch;
+        if (!this->program->mayMatch(from, endOfStr))
+            return NoMatch;
+        lease_t lease(*this);
+
+        return this->search(lease.scratch, startOfStr, endOfStr, from, slots, budget);
+    }
+
+    // search() with a scratch already taken
+    int     Regex::search(scratch_t &scratch, const char *startOfStr,
+        const char *endOfStr, const char *from, std::vector<const char *> &slots,
+        RegexBudget *budget) const
+    {
+        const char  *lastStart = endOfStr;
+
+        // when every match ends at a line end, the reverse DFA reads the
+        // input backwards and finds where the leftmost match starts.
+        // It reads the whole input, only the first search of an input uses it
+        if (scratch.reverseDFA && from == startOfStr)
         {
-            const char* start = str + i;
-            if (this->root->match(start, 0, &info, &fn))
+            int res = scratch.reverseDFA->searchReverse(startOfStr, endOfStr, &from);
+            if (res == RegexLazyDFA::NoMatch)
+                return NoMatch;
+            if (res == RegexLazyDFA::Match)
+                lastStart = from;
+            else
+                from = startOfStr;
+        }
+        // the DFA rejects the inputs without a match in one pass, otherwise
+        // it gives the end of the first match to end, no match found by
+        // the start loop can start after it
+        if (scratch.dfa && lastStart == endOfStr)
+        {
+            int res = scratch.dfa->search(startOfStr, from, endOfStr, &lastStart);
+            if (res == RegexLazyDFA::NoMatch)
+                return NoMatch;
+            if (res == RegexLazyDFA::GaveUp)
+                lastStart = endOfStr;
+        }
+        // the Pike VM does not run back-references nor counted loops
+        bool    pikeable = !this->program->hasBackReference
+            && this->program->counters.empty();
+        bool    linear = (flags & Regex::pikeVM) && pikeable;
+        if (!linear)
+        {
+            int res = scratch.backtracker->search(startOfStr, endOfStr, from,
+                lastStart, slots, budget);
+            if (res == RegexBacktracker::Aborted)
+                return Aborted;
+            if (res != RegexBacktracker::OutOfMemory)
+                return res == RegexBacktracker::Match ? Match : NoMatch;
+            // the Pike VM needs memory proportional to the program only
+            // and gives the same match and groups as the backtracker
+            if (!pikeable)
+                throw BacktrackLimitException();
+            linear = true;
+        }
+        scratch.pike->setInput(startOfStr, endOfStr);
+        return scratch.pike->search(from, slots) ? Match : NoMatch;
+    }
+
+    // slots hold the bounds of each group as [2 * id, 2 * id + 1].
+    // The strings of a reused result_t keep their buffers
+    void    Regex::fillResult(std::vector<const char *> const& slots, result_t &r) const
+    {
+        r.groups.resize(this->program->groups);
+        for (size_t j = 0; j < this->program->groups; j++)
+        {
+            if (slots[2 * j] > slots[2 * j + 1])
+                r.groups[j].clear();
+            else
+                r.groups[j].assign(slots[2 * j], slots[2 * j + 1]);
+        }
+        r.str = r.groups[0];
+    }
+
+    std::vector<Regex::result_t> Regex::matchAll(std::string const& str) const
+    {
+        return this->matchAll(str.data(), str.size());
+    }
+
+    std::vector<Regex::result_t> Regex::matchAll(const char *str) const
+    {
+        return this->matchAll(str, std::strlen(str));
+    }
+
+    std::vector<Regex::result_t> Regex::matchAll(const char *str, size_t len) const
+    {
+        std::vector<result_t> result;
+        MatchIterator it(*this, str, len);
+        while (it.next())
+        {
+            result.resize(result.size() + 1);
+            this->fillResult(it.result().slots, result.back());
+        }
+        return result;
+    }
+
+    // Start limit_t
+
+    Regex::limit_t::limit_t(size_t steps) : steps(steps)
+    {
+        this->deadline.tv_sec = 0;
+        this->deadline.tv_usec = 0;
+    }
+
+    void    Regex::limit_t::timeout(unsigned long ms)
+    {
+        gettimeofday(&this->deadline, NULL);
+        this->deadline.tv_sec += ms / 1000 + (this->deadline.tv_usec + ms % 1000 * 1000) / 1000000;
+        this->deadline.tv_usec = (this->deadline.tv_usec + ms % 1000 * 1000) % 1000000;
+    }
+
+    // END limit_t
+
+    // Start match_t
+
+    Regex::match_t::match_t() : data(NULL) {}
+
+    size_t  Regex::match_t::groups() const
+    {
+        return this->slots.size() / 2;
+    }
+
+    // an unset group is empty and starts where the match does
+    const char  *Regex::match_t::begin(size_t id) const
+    {
+        if (!this->slots[2 * id] || this->slots[2 * id] > this->slots[2 * id + 1])
+            return this->slots[0];
+        return this->slots[2 * id];
+    }
+
+    const char  *Regex::match_t::end(size_t id) const
+    {
+        if (!this->slots[2 * id] || this->slots[2 * id] > this->slots[2 * id + 1])
+            return this->slots[0];
+        return this->slots[2 * id + 1];
+    }
+
+    size_t  Regex::match_t::position(size_t id) const
+    {
+        return this->begin(id) - this->data;
+    }
+
+    size_t  Regex::match_t::length(size_t id) const
+    {
+        return this->end(id) - this->begin(id);
+    }
+
+    std::string Regex::match_t::str(size_t id) const
+    {
+        return std::string(this->begin(id), this->end(id));
+    }
+
+    // END match_t
+
+    // Start MatchIterator
+
+    Regex::MatchIterator::MatchIterator(Regex const& regex, const char *data, size_t len) :
+        regex(regex), endOfStr(data + len), pos(data)
+    {
+        this->current.data = data;
+    }
+
+    // the next search starts where the last match ended, or one byte
+    // after it when the match was empty so it is not found again
+    bool    Regex::MatchIterator::next()
+    {
+        if (!this->pos || this->regex.search(this->current.data, this->endOfStr,
+            this->pos, this->current.slots) != Match)
+        {
+            this->pos = NULL;
+            return false;
+        }
+        std::vector<const char *>   &slots = this->current.slots;
+        slots.resize(2 * this->regex.program->groups);
+        this->pos = slots[1] > slots[0] ? slots[1] : slots[0] + 1;
+        return true;
+    }
+
+    void    Regex::MatchIterator::seek(const char *pos)
+    {
+        if (this->pos)
+            this->pos = pos <= this->endOfStr ? pos : NULL;
+    }
+
+    Regex::match_t const&   Regex::MatchIterator::result() const
+    {
+        return this->current;
+    }
+
+    // END MatchIterator
+
+    bool    Regex::test(const char *str) const
+    {
+        return this->test(str, std::strlen(str));
+    }
+
+    bool    Regex::test(const char *str, size_t len) const
+    {
+        if (!this->program->mayMatch(str, str + len))
+            return false;
+        lease_t lease(*this);
+
+        return this->test(lease.scratch, str, len);
+    }
+
+    bool    Regex::test(scratch_t &scratch, const char *str, size_t len) const
+    {
+        const char  *endOfStr = str + len;
+
+        if (scratch.dfa)
+        {
+            int         res = scratch.dfa->search(str, str, endOfStr);
+            if (res != RegexLazyDFA::GaveUp)
+                return res == RegexLazyDFA::Match;
+            // the cache keeps being flushed, fall back to the NFA
+            scratch.pike->setInput(str, endOfStr);
+            return scratch.pike->search(str, scratch.slots);
+        }
+        // like match(), an empty input has no match
+        return len && this->search(scratch, str, endOfStr, str, scratch.slots) == Match;
+    }
+
+    void    Regex::setDFABudget(size_t bytes)
+    {
+        this->dfaBudget = bytes;
+    }
+
+    void    Regex::setBacktrackLimit(size_t bytes)
+    {
+        this->backtrackLimit = bytes;
+    }
+
+    void    Regex::setMemoLimit(size_t bytes)
+    {
+        this->memoLimit = bytes;
+    }
+
+    size_t  Regex::memoryUsage() const
+    {
+        size_t  bytes = sizeof(Regex) + this->arena.size()
+            + this->regex.capacity()
+            + this->inner_groups.capacity() * sizeof(RegexStartOfGroup *);
+
+        bytes += this->program->memoryUsage();
+        if (this->reverseProgram)
+            bytes += this->reverseProgram->memoryUsage();
+        return bytes;
+    }
+
+    bool    Regex::test(std::string const& str) const
+    {
+        return this->test(str.data(), str.size());
+    }
+
+    // Start column_t
+
+    Regex::column_t::column_t(const char *data, const int *offsets, size_t rows) :
+        data(data), offsets32(offsets), offsets64(NULL), rows(rows) {}
+
+    Regex::column_t::column_t(const char *data, const long long *offsets, size_t rows) :
+        data(data), offsets32(NULL), offsets64(offsets), rows(rows) {}
+
+    const char  *Regex::column_t::begin(size_t row) const
+    {
+        return this->data + (this->offsets32 ? this->offsets32[row] : this->offsets64[row]);
+    }
+
+    const char  *Regex::column_t::end(size_t row) const
+    {
+        return this->begin(row + 1);
+    }
+
+    // END column_t
+
+    enum
+    {
+        SliceDone,
+        SliceBacktrackLimit,
+        SliceOutOfMemory,
+        SliceFailed,            // any other exception
+    };
+
+    // The scratch is taken once for the slice rather than once per row,
+    // which is most of the time test() takes on a short string
+    void    Regex::filterSlice(slice_t &slice) const
+    {
+        column_t const& column = *slice.column;
+
+        try
+        {
+            lease_t         lease(*this);
+            scratch_t       &scratch = lease.scratch;
+            unsigned char   bits = 0;
+
+            for (size_t row = slice.begin; row < slice.end; row++)
             {
-                for (size_t j = 0; j < this->inner_groups.size(); j++)
+                const char  *begin = column.begin(row);
+                const char  *end = column.end(row);
+
+                if (this->program->mayMatch(begin, end)
+                    && this->test(scratch, begin, end - begin))
+                {
+                    bits |= 1 << (row & 7);
+                    slice.count++;
+                }
+                if ((row & 7) == 7 || row + 1 == slice.end)
                 {
-                    
-                    if (this->inner_groups[j]->getCapturedGroup().first > this->inner_groups[j]->getCapturedGroup().second)
-                        r.groups.push_back("");
-                    else 
-                    {
-                        std::string group(this->inner_groups[j]->getCapturedGroup().first,
-                                      this->inner_groups[j]->getCapturedGroup().second);
-                        r.groups.push_back(group);
-                    }
-                    if (j == 0)
-                        r.str = r.groups.back();
-                    this->inner_groups[j]->component.group->first = NULL;
-                    this->inner_groups[j]->component.group->second = NULL;
+                    slice.mask[row >> 3] = bits;
+                    bits = 0;
                 }
-                return true;
             }
         }
-        return false;
+        catch (BacktrackLimitException const&)
+        {
+            slice.error = SliceBacktrackLimit;
+        }
+        catch (std::bad_alloc const&)
+        {
+            slice.error = SliceOutOfMemory;
+        }
+        // an exception leaving the thread would terminate the process
+        catch (...)
+        {
+            slice.error = SliceFailed;
+        }
     }
 
-    std::vector<Regex::result_t> Regex::matchAll(std::string const& str)
+    void    *Regex::runSlice(void *arg)
     {
-        return this->matchAll(str.c_str());
+        slice_t *slice = static_cast<slice_t *>(arg);
+
+        slice->regex->filterSlice(*slice);
+        return NULL;
     }
 
-    std::vector<Regex::result_t> Regex::matchAll(const char *str)
+    size_t  Regex::filter(column_t const& column, std::vector<unsigned char> &mask,
+        size_t threads) const
     {
-        std::vector<result_t> result(1);
-        while (this->match(str, result.back()))
+        size_t  slices = std::min(threads, column.rows / MinRowsPerThread);
+
+        mask.assign((column.rows + 7) / 8, 0);
+        if (!slices)
+            slices = 1;
+        // the slices but the last one hold a multiple of 8 rows
+        size_t                  rows = ((column.rows + slices - 1) / slices + 7) & ~size_t(7);
+        std::vector<slice_t>    parts(slices);
+        std::vector<pthread_t>  ids(slices);
+        std::vector<bool>       started(slices, false);
+
+        for (size_t i = 0; i < slices; i++)
+        {
+            slice_t &part = parts[i];
+
+            part.regex = this;
+            part.column = &column;
+            part.mask = mask.empty() ? NULL : &mask[0];
+            part.begin = std::min(i * rows, column.rows);
+            part.end = i + 1 == slices ? column.rows : std::min(part.begin + rows, column.rows);
+            part.count = 0;
+            part.error = SliceDone;
+        }
+        // the first slice is run by the calling thread, so is a slice
+        // whose thread cannot be created
+        for (size_t i = 1; i < slices; i++)
+            started[i] = !pthread_create(&ids[i], NULL, &Regex::runSlice, &parts[i]);
+        for (size_t i = 0; i < slices; i++)
+            if (!started[i])
+                this->filterSlice(parts[i]);
+
+        size_t  count = 0;
+        int     error = SliceDone;
+        for (size_t i = 0; i < slices; i++)
         {
-           result.resize(result.size() + 1);
+            if (started[i])
+                pthread_join(ids[i], NULL);
+            count += parts[i].count;
+            if (parts[i].error != SliceDone)
+                error = parts[i].error;
         }
-        result.pop_back();
-        return result;
+        if (error == SliceBacktrackLimit)
+            throw BacktrackLimitException();
+        if (error == SliceOutOfMemory)
+            throw std::bad_alloc();
+        if (error == SliceFailed)
+            throw std::runtime_error("Regex: filter() failed in one of its threads");
+        return count;
     }
 
-    bool    Regex::test(const char *str)
+    size_t  Regex::select(column_t const& column, std::vector<size_t> &selection,
+        size_t threads) const
     {
-        result_t r;
-        return this->match(str, r);
-    }
+        std::vector<unsigned char>  mask;
+        size_t                      count = this->filter(column, mask, threads);
 
-    bool    Regex::test(std::string const& str)
-    {
-        return this->test(str.c_str());
+        selection.clear();
+        selection.reserve(count);
+        for (size_t i = 0; i < mask.size(); i++)
+            for (unsigned int bits = mask[i]; bits; bits &= bits - 1)
+                selection.push_back(i * 8 + __builtin_ctz(bits));
+        return count;
     }
 
+    // the scratch refer to the programs
     Regex::~Regex() {
-        delete this->root;
+        this->pool.clear();
+        delete this->reverseProgram;
+        delete this->program;
     }
 
     char Regex::peek()
@@ -265,12 +806,13 @@ namespace ft
     Regex::ret_t
     Regex::expr()
     {
+        size_t  begin = offset();
         ret_t t = term();
         if (hasMoreChars() && peek() == '|')
         {
             eat('|', "expected '|'");
             ret_t e = expr();
-            return alter(t, e);
+            return spanned(alter(t, e), begin);
         }
         return t;
     }
@@ -279,11 +821,12 @@ namespace ft
     Regex::ret_t
     Regex::term()
     {
+        size_t  begin = offset();
         ret_t f = factor();
         if (hasMoreChars() && peek() != ')' && peek() != '|')
         {
             ret_t t = term();
-            return concat(f, t);
+            return spanned(concat(f, t), begin);
         }
 
         return f;
@@ -292,6 +835,7 @@ namespace ft
     Regex::ret_t
     Regex::factor()
     {
+        size_t  begin = offset();
         ret_t a = atom();
         // disable repeat for (?<=...) and (?<!...)
         if (hasMoreChars() && isRepeatChar(peek()))
@@ -299,7 +843,7 @@ namespace ft
             if (!allowed_repeat)
                 throw InvalidRegexException("Unexpected repeat inside lookup group");
             char r = next();
-            return repeat(a, r);
+            return spanned(repeat(a, r), begin);
         }
         else if (hasMoreChars() && peek() == '{')
         {
@@ -308,7 +852,7 @@ namespace ft
             eat('{', "expected '{'");
             std::pair<long long, long long> r = repeat_range();
             eat('}', "expected '}'");
-            return repeat(a, r.first, r.second);
+            return spanned(repeat(a, r.first, r.second), begin);
         }
         return a;
     }
@@ -332,21 +876,47 @@ namespace ft
     Regex::ret_t
     Regex::atom()
     {
+        size_t  begin = offset();
         if (hasMoreChars() && peek() == '(')
         {
             eat('(', "expected '('");
             ret_t const& grp = group();
             eat(')', "expected ')'");
-            return grp;
+            return spanned(grp, begin);
         }
         else if (hasMoreChars() && peek() == '[')
         {
             eat('[', "expected '['");
             RegexComponentBase *res = charGroup();
             eat(']', "expected ']'");
-            return ret_t(1, 1 , res);
+            return spanned(ret_t(1, 1 , foldCase(res)), begin);
         }
-        return ret_t(1, 1, chr());
+        return spanned(ret_t(1, 1, foldCase(chr())), begin);
+    }
+
+    size_t
+    Regex::offset() const
+    {
+        return this->current - this->regex.begin();
+    }
+
+    Regex::ret_t
+    Regex::spanned(ret_t ret, size_t begin)
+    {
+        ret.c->begin = begin;
+        ret.c->end = offset();
+        return ret;
+    }
+
+    // the case folding is done once here so the matcher only has to
+    // test one bit per character
+    RegexComponentBase*
+    Regex::foldCase(RegexComponentBase *c)
+    {
+        if ((flags & Regex::iCase) && (c->type == RegexComponentBase::GROUP
+            || c->type == RegexComponentBase::INVERSE_GROUP))
+            c->component.chars->foldCase();
+        return c;
     }
 
     Regex::ret_t
@@ -375,7 +945,7 @@ namespace ft
                 ret_t ret = expr_without_repeat();
                 if (c == '=')
                 {
-                    RegexComponentBase *res = new RegexPositiveLookBehind();
+                    RegexComponentBase *res = new (this->arena) RegexPositiveLookBehind(this->arena);
                     res->component.range->child = ret.c;
                     res->component.range->min = ret.min.value;
                     res->component.range->max = ret.max.value;
@@ -383,7 +953,7 @@ namespace ft
                 }
                 else if (c == '!')
                 {
-                    RegexComponentBase *res = new RegexNegativeLookBehind();
+                    RegexComponentBase *res = new (this->arena) RegexNegativeLookBehind(this->arena);
                     res->component.range->child = ret.c;
                     res->component.range->min = ret.min.value;
                     res->component.range->max = ret.max.value;
@@ -393,7 +963,7 @@ namespace ft
             else if (c == '=')
             {
                 ret_t ret = expr_without_repeat();
-                RegexComponentBase *res = new RegexPositiveLookAhead();
+                RegexComponentBase *res = new (this->arena) RegexPositiveLookAhead(this->arena);
                 res->component.range->child = ret.c;
                 res->component.range->min = ret.min.value;
                 res->component.range->max = ret.max.value;
@@ -402,7 +972,7 @@ namespace ft
             else if (c == '!')
             {
                 ret_t ret = expr_without_repeat();
-                RegexComponentBase *res = new RegexNegativeLookAhead();
+                RegexComponentBase *res = new (this->arena) RegexNegativeLookAhead(this->arena);
                 res->component.range->child = ret.c;
                 res->component.range->min = ret.min.value;
                 res->component.range->max = ret.max.value;
@@ -411,10 +981,16 @@ namespace ft
             else
                 throw InvalidRegexException("unexpected char after '?'");
         }
-        RegexStartOfGroup *group = new RegexStartOfGroup();
+        RegexStartOfGroup *group =
+            new (this->arena) RegexStartOfGroup(this->arena, inner_groups.size());
         inner_groups.push_back(group);
-        RegexEndOfGroup *end = new RegexEndOfGroup(group);
+        RegexEndOfGroup *end = new (this->arena) RegexEndOfGroup(this->arena, group);
+        // the parentheses, the closing one is next
+        group->begin = offset() - 1;
+        group->end = offset();
         ret_t const& res = expr();
+        end->begin = offset();
+        end->end = offset() + 1;
         return concat(ret_t(0, 0, group), concat(res, ret_t(0, 0, end)));
     }
     
@@ -425,10 +1001,10 @@ namespace ft
         if (hasMoreChars() && peek() == '^')
         {
             eat('^', "expected '^'");
-            res = new RegexInverseGroup();
+            res = new (this->arena) RegexInverseGroup(this->arena);
         }
         else
-            res = new RegexGroup();
+            res = new (this->arena) RegexGroup(this->arena);
         if (hasMoreChars() && peek() == ']')
             throw InvalidRegexException("unexpected character ']'");
         return charGroupBody(res);
@@ -462,22 +1038,18 @@ namespace ft
     RegexComponentBase*
     Regex::charGroupSkiped(char c, RegexComponentBase*res)
     {
+        CharClass   cls;
+
         if (c == 'd' || c == 'D')
-            res->addRangeChar('0', '9');
+            cls = CharClass::digit();
         else if (c == 'w' || c == 'W')
-        {
-            res->addRangeChar('a', 'z');
-            res->addRangeChar('A', 'Z');
-            res->addRangeChar('0', '9');
-            res->addChar('_');
-        }
+            cls = CharClass::word();
         else if (c == 's' || c == 'S')
-        {
-            res->addRangeChar(' ', ' ');
-            res->addRangeChar('\t', '\t');
-            res->addRangeChar('\n', '\n');
-            res->addRangeChar('\r', '\r');
-        }
+            cls = CharClass::space();
+        if (c == 'D' || c == 'W' || c == 'S')
+            cls.invert();
+        if (c == 'd' || c == 'D' || c == 'w' || c == 'W' || c == 's' || c == 'S')
+            res->component.chars->addClass(cls);
         else if (c == 'n')
             res->addChar('\n');
         else if (c == 'r')
@@ -509,8 +1081,7 @@ namespace ft
             char c2 = next();
             if (c2 < c)
                 throw InvalidRegexException("invalid range");
-            for (char i = c; i <= c2; i++)
-                res->addChar(i);
+            res->addRangeChar(c, c2);
         } else
         {
             res->addChar(c);
@@ -535,20 +1106,20 @@ namespace ft
         else if (peek() == '.')
         {
             eat('.', "expected '.'");
-            return new RegexInverseGroup('\n');
+            return new (this->arena) RegexInverseGroup(this->arena, '\n');
         }
         else if (peek() == '^')
         {
             eat('^', "expected '^'");
-            return new RegexStartOfLine();
+            return new (this->arena) RegexStartOfLine(this->arena);
         }
         else if (peek() == '$')
         {
             eat('$', "expected '$'");
-            return new RegexEndOfLine();
+            return new (this->arena) RegexEndOfLine(this->arena);
         }
  
-        RegexGroup *res = new RegexGroup();
+        RegexGroup *res = new (this->arena) RegexGroup(this->arena);
         res->addChar(next());
         return res;
     }
@@ -562,93 +1133,80 @@ namespace ft
             long long n = integer();
             if (n >= static_cast<long long>(inner_groups.size()))
                 throw InvalidRegexException("Invalid group reference");
-            RegexBackReference *ref = new RegexBackReference(inner_groups[n]);
+            RegexBackReference *ref =
+                new (this->arena) RegexBackReference(this->arena, inner_groups[n]);
             return ref;
         }
         else if (peek() == 'd')
         {
             next();
-            return new RegexGroup('0', '9');
+            return new (this->arena) RegexGroup(this->arena, CharClass::digit());
         }
         else if (peek() == 'D')
         {
             next();
-            return new RegexInverseGroup('0', '9');
+            return new (this->arena) RegexInverseGroup(this->arena, CharClass::digit());
         }
         else if (peek() == 'w')
         {
             next();
-            RegexGroup *r = new RegexGroup ('a', 'z');
-            r->addRangeChar('A', 'Z');
-            r->addRangeChar('0', '9');
-            r->addChar('_');
-            return r;
+            return new (this->arena) RegexGroup(this->arena, CharClass::word());
         }
         else if (peek() == 'W')
         {
             next();
-            RegexInverseGroup *r = new RegexInverseGroup('a', 'z');
-            r->addRangeChar('A', 'Z');
-            r->addRangeChar('0', '9');
-            r->addChar('_');
-            return r;
+            return new (this->arena) RegexInverseGroup(this->arena, CharClass::word());
         }
         else if (peek() == 's')
         {
             next();
-            RegexGroup *r = new RegexGroup();
-            r->addRangeChar('\t', '\r');
-            r->addChar(' ');
-            return r;
+            return new (this->arena) RegexGroup(this->arena, CharClass::space());
         }
         else if (peek() == 'S')
         {
             next();
-            RegexInverseGroup *r = new RegexInverseGroup();
-            r->addRangeChar('\t', '\r');
-            r->addChar(' ');
-            return r;
+            return new (this->arena) RegexInverseGroup(this->arena, CharClass::space());
         }
         else if (peek() == 'b')
         {
             next();
-            return new RegexWordBoundary();
+            return new (this->arena) RegexWordBoundary(this->arena);
         }
         else if (peek() == 'B')
         {
             next();
-            return new RegexNonWordBoundary();
+            return new (this->arena) RegexNonWordBoundary(this->arena);
         }
         else if (peek() == 't')
         {
             next();
-            return new RegexGroup('\t');
+            return new (this->arena) RegexGroup(this->arena, '\t');
         }
         else if (peek() == 'n')
         {
             next();
-            return new RegexGroup('\n');
+            return new (this->arena) RegexGroup(this->arena, '\n');
         }
         else if (peek() == 'r')
         {
             next();
-            return new RegexGroup('\r');
+            return new (this->arena) RegexGroup(this->arena, '\r');
         }
         else if (peek() == 'f')
         {
             next();
-            return new RegexGroup('\f');
+            return new (this->arena) RegexGroup(this->arena, '\f');
         }
         else if (peek() == 'a')
         {
             next();
-            return new RegexGroup('\a');
+            return new (this->arena) RegexGroup(this->arena, '\a');
         }
         else
         {
             char c = peek();
             next();
-            return new RegexGroup(c);
+            return new (this->arena) RegexGroup(this->arena, c);
         }
 
     }
@@ -683,7 +1241,7 @@ namespace ft
         }
         else
         {
-            RegexConcat *res = new RegexConcat();
+            RegexConcat *res = new (this->arena) RegexConcat(this->arena);
             res->addChild(a.c);
             res->addChild(b.c);
             return ret_t(a.min + b.min, a.max + b.max, res);
@@ -707,7 +1265,7 @@ namespace ft
         }
         else
         {
-            RegexAlternate *res = new RegexAlternate();
+            RegexAlternate *res = new (this->arena) RegexAlternate(this->arena);
             res->addChild(a.c);
             res->addChild(b.c);
             return  ret_t(std::min(a.min, b.min), std::max(a.max, b.max), res);
@@ -740,13 +1298,13 @@ namespace ft
             return ret_t(
                 std::min(min * a.min, CustomLongLong(Regex::Infinity)), 
                 std::min(max * a.max, CustomLongLong(Regex::Infinity)),
-                new RegexRepeatLazy(a.c, min, max)
+                new (this->arena) RegexRepeatLazy(this->arena, a.c, min, max)
             );
         }
         return ret_t(
                 std::min(min * a.min, CustomLongLong(Regex::Infinity)), 
                 std::min(max * a.max, CustomLongLong(Regex::Infinity)),
-                new RegexRepeat(a.c, min, max)
+                new (this->arena) RegexRepeat(this->arena, a.c, min, max)
         );
     }
 
@@ -0,0 +1,391 @@
+#include <RegexProgram.hpp>
+#include <algorithm>
+
+namespace ft
+{
+    // the body of a loop is the instructions between its MARK and its PROGRESS
+    RegexBacktracker::RegexBacktracker(RegexProgram const& prog, size_t limit,
+        size_t memoLimit) : prog(prog), limit(limit), startOfStr(NULL), endOfStr(NULL),
+        budget(NULL), memoizable(!prog.hasBackReference && prog.counters.empty()),
+        memoLimit(memoLimit), memo(false),
+        memoBase(NULL), visitedHigh(0), profile(NULL)
+    {
+        for (size_t mark = 0; mark < prog.insts.size(); mark++)
+        {
+            if (prog.insts[mark].op != RegexInst::MARK)
+                continue;
+            if (this->loopMarks.empty())
+                this->loopMarks.resize(prog.insts.size());
+            for (size_t pc = mark + 1; prog.insts[pc].op != RegexInst::PROGRESS
+                || prog.insts[pc].x != prog.insts[mark].x; pc++)
+            {
+                if (prog.insts[pc].op == RegexInst::SPLIT)
+                    this->loopMarks[pc].push_back(prog.insts[mark].x);
+            }
+        }
+    }
+
+    void    RegexBacktracker::setLimit(size_t limit)
+    {
+        this->limit = limit;
+    }
+
+    void    RegexBacktracker::setMemoLimit(size_t limit)
+    {
+        this->memoLimit = limit;
+        if (this->visited.size() * sizeof(unsigned int) > limit)
+        {
+            std::vector<unsigned int>().swap(this->visited);
+            this->visitedHigh = 0;
+        }
+    }
+
+    void    RegexBacktracker::setProfile(RegexProfile *profile)
+    {
+        this->profile = profile;
+    }
+
+    // false when the SPLIT at pc was already reached at pos
+    bool    RegexBacktracker::visit(int pc, const char *pos,
+        std::vector<const char *> const& slots)
+    {
+        if (!this->loopMarks.empty())
+        {
+            std::vector<int> const& marks = this->loopMarks[pc];
+            for (size_t i = 0; i < marks.size(); i++)
+                if (slots[marks[i]] == pos)
+                    return true;
+        }
+
+        size_t          bit = (pos - this->memoBase) * this->prog.insts.size() + pc;
+        size_t          word = bit / 32;
+        unsigned int    mask = 1u << (bit % 32);
+
+        if (this->visited[word] & mask)
+            return false;
+        this->visited[word] |= mask;
+        if (word >= this->visitedHigh)
+            this->visitedHigh = word + 1;
+        return true;
+    }
+
+    bool    RegexBacktracker::push(int pc, int slot, const char *pos)
+    {
+        if ((this->stack.size() + 1) * sizeof(Frame) > this->limit)
+            return false;
+        Frame   frame;
+        frame.pc = pc;
+        frame.slot = slot;
+        frame.pos = pos;
+        this->stack.push_back(frame);
+        return true;
+    }
+
+    // the alternative on top of the stack was pushed by the instruction at pc
+    void    RegexBacktracker::pushed(int pc)
+    {
+        if (this->pushers.size() < this->stack.size())
+            this->pushers.resize(this->stack.size());
+        this->pushers[this->stack.size() - 1] = pc;
+    }
+
+    void    RegexBacktracker::went(int from, int to)
+    {
+        RegexProfile::Counts    &counts = this->profile->insts[from];
+
+        if (to == from + 1)
+            counts.next++;
+        else if (to == this->prog.insts[from].x)
+            counts.x++;
+        else
+            counts.y++;
+    }
+
+    static bool isWordChar(const char *ptr, const char *startOfStr, const char *endOfStr)
+    {
+        return ptr >= startOfStr && ptr < endOfStr
+            && CharClass::word().has(static_cast<unsigned char>(*ptr));
+    }
+
+    // Matches the sub-program at pc from pos, no character at or after
+    // stop is consumed. The frames pushed by the run are popped before it
+    // returns, on a match slots keeps the captures of the match
+    template<bool Profiled>
+    int     RegexBacktracker::run(int pc, const char *pos, const char *stop,
+        bool mustEndAtStop, std::vector<const char *> &slots)
+    {
+        size_t  base = this->stack.size();
+
+        for (;;)
+        {
+            bool    failed = false;
+
+            while (!failed)
+            {
+                RegexInst const&    inst = this->prog.insts[pc];
+                int                 from = pc;
+                bool                word;
+
+                if (Profiled)
+                    this->profile->insts[pc].runs++;
+                switch (inst.op)
+                {
+                case RegexInst::CHAR_CLASS:
+                    if (pos < stop && this->prog.classes[inst.x]
+                        .has(static_cast<unsigned char>(*pos)))
+                    {
+                        pos++;
+                        pc++;
+                    }
+                    else
+                        failed = true;
+                    break;
+                case RegexInst::SPLIT:
+                    if (this->budget && !this->budget->spend())
+                        return Aborted;
+                    if (this->memo && !this->visit(pc, pos, slots))
+                    {
+                        failed = true;
+                        break;
+                    }
+                    if (!this->push(inst.y, -1, pos))
+                        return OutOfMemory;
+                    if (Profiled)
+                        this->pushed(pc);
+                    pc = inst.x;
+                    break;
+                case RegexInst::JMP:
+                    pc = inst.x;
+                    break;
+                case RegexInst::SAVE:
+                case RegexInst::MARK:
+                    if (!this->push(-1, inst.x, slots[inst.x]))
+                        return OutOfMemory;
+                    slots[inst.x] = pos;
+                    pc++;
+                    break;
+                case RegexInst::PROGRESS:
+                    pc = slots[inst.x] == pos ? inst.y : pc + 1;
+                    break;
+                case RegexInst::REPEAT_START:
+                case RegexInst::COUNT:
+                    if (!this->push(this->counts[inst.x], -2 - inst.x, NULL))
+                        return OutOfMemory;
+                    if (inst.op == RegexInst::COUNT)
+                    {
+                        this->counts[inst.x]++;
+                        pc = inst.y;
+                        break;
+                    }
+                    this->counts[inst.x] = 0;
+                    pc++;
+                    break;
+                case RegexInst::REPEAT:
+                {
+                    int count = this->counts[inst.x];
+                    if (count < this->prog.counters[inst.x].first)
+                    {
+                        pc++;
+                        break;
+                    }
+                    if (count == this->prog.counters[inst.x].second)
+                    {
+                        pc = inst.y;
+                        break;
+                    }
+                    // a SPLIT between the body and the exit
+                    if (this->budget && !this->budget->spend())
+                        return Aborted;
+                    if (!this->push(inst.z ? pc + 1 : inst.y, -1, pos))
+                        return OutOfMemory;
+                    if (Profiled)
+                        this->pushed(pc);
+                    pc = inst.z ? inst.y : pc + 1;
+                    break;
+                }
+                case RegexInst::START_OF_LINE:
+                    failed = !(pos == this->startOfStr || *(pos - 1) == '\n');
+                    pc++;
+                    break;
+                case RegexInst::END_OF_LINE:
+                    failed = !(pos == this->endOfStr || *pos == '\n');
+                    pc++;
+                    break;
+                case RegexInst::WORD_BOUNDARY:
+                case RegexInst::NON_WORD_BOUNDARY:
+                    word = isWordChar(pos - 1, this->startOfStr, this->endOfStr)
+                        != isWordChar(pos, this->startOfStr, this->endOfStr);
+                    failed = word != (inst.op == RegexInst::WORD_BOUNDARY);
+                    pc++;
+                    break;
+                case RegexInst::BACK_REFERENCE:
+                {
+                    // an unset or empty group matches the empty string,
+                    // one that is not closed yet does not match
+                    const char  *start = slots[2 * inst.x];
+                    const char  *end = slots[2 * inst.x + 1];
+                    if (start && start != end)
+                    {
+                        if (!end || start > end || stop - pos < end - start
+                            || !std::equal(start, end, pos))
+                        {
+                            failed = true;
+                            break;
+                        }
+                        pos += end - start;
+                    }
+                    pc++;
+                    break;
+                }
+                case RegexInst::LOOK_AHEAD:
+                case RegexInst::LOOK_BEHIND:
+                case RegexInst::NEGATIVE_LOOK_AHEAD:
+                case RegexInst::NEGATIVE_LOOK_BEHIND:
+                {
+                    int res = this->lookAround<Profiled>(inst, pos, slots);
+                    if (res != Match && res != NoMatch)
+                        return res;
+                    failed = (res == Match) != (inst.op == RegexInst::LOOK_AHEAD
+                        || inst.op == RegexInst::LOOK_BEHIND);
+                    pc++;
+                    break;
+                }
+                case RegexInst::MATCH:
+                    if (mustEndAtStop && pos != stop)
+                    {
+                        failed = true;
+                        break;
+                    }
+                    this->stack.resize(base);
+                    return Match;
+                default:
+                    failed = true;
+                    break;
+                }
+                if (Profiled && failed)
+                    this->profile->insts[from].fails++;
+                else if (Profiled)
+                    this->went(from, pc);
+            }
+
+            // resume at the last alternative, undoing the captures made since
+            for (;;)
+            {
+                if (this->stack.size() == base)
+                    return NoMatch;
+                Frame   frame = this->stack.back();
+                this->stack.pop_back();
+                if (frame.slot >= 0)
+                    slots[frame.slot] = frame.pos;
+                else if (frame.slot < -1)
+                    this->counts[-2 - frame.slot] = frame.pc;
+                else
+                {
+                    if (this->budget && !this->budget->spend())
+                        return Aborted;
+                    if (Profiled)
+                    {
+                        int pusher = this->pushers[this->stack.size()];
+                        this->profile->insts[pusher].resumed++;
+                        this->went(pusher, frame.pc);
+                    }
+                    pc = frame.pc;
+                    pos = frame.pos;
+                    break;
+                }
+            }
+        }
+    }
+
+    // a positive look-around keeps the captures of its body, they are
+    // undone like the other ones when backtracking before it.
+    // A look-behind tries every width from the shortest one.
+    // The sub-runs stop at their first match or at another position than
+    // the main run, they do not use the memo
+    template<bool Profiled>
+    int     RegexBacktracker::lookAround(RegexInst const& inst, const char *pos,
+        std::vector<const char *> &slots)
+    {
+        std::vector<const char *>   before(slots);
+        int                         res = NoMatch;
+        bool                        memo = this->memo;
+
+        this->memo = false;
+        if (inst.op == RegexInst::LOOK_AHEAD
+            || inst.op == RegexInst::NEGATIVE_LOOK_AHEAD)
+        {
+            if (Profiled)
+                this->profile->insts[&inst - this->prog.insts.data()].x++;
+            res = this->run<Profiled>(inst.x, pos, this->endOfStr, false, slots);
+        }
+        else
+        {
+            for (int width = inst.y; width <= inst.z && res == NoMatch; width++)
+            {
+                if (pos - this->startOfStr < width)
+                    break;
+                if (Profiled)
+                    this->profile->insts[&inst - this->prog.insts.data()].x++;
+                res = this->run<Profiled>(inst.x, pos - width, pos, true, slots);
+            }
+        }
+        this->memo = memo;
+        if (res != Match || inst.op == RegexInst::NEGATIVE_LOOK_AHEAD
+            || inst.op == RegexInst::NEGATIVE_LOOK_BEHIND)
+        {
+            slots.swap(before);
+            return res;
+        }
+        for (size_t i = 0; i < slots.size(); i++)
+            if (slots[i] != before[i] && !this->push(-1, i, before[i]))
+                return OutOfMemory;
+        return Match;
+    }
+
+    int     RegexBacktracker::search(const char *startOfStr, const char *endOfStr,
+        const char *from, const char *lastStart, std::vector<const char *> &slots,
+        RegexBudget *budget)
+    {
+        this->startOfStr = startOfStr;
+        this->endOfStr = endOfStr;
+        this->budget = budget;
+        this->stack.clear();
+        this->counts.resize(this->prog.counters.size());
+        // a failed state fails whatever the start position is, the bits
+        // are kept for the whole search
+        size_t  words = ((endOfStr - from + 1) * this->prog.insts.size() + 31) / 32;
+        this->memo = this->memoizable && words * sizeof(unsigned int) <= this->memoLimit;
+        if (this->memo)
+        {
+            std::fill(this->visited.begin(),
+                this->visited.begin() + this->visitedHigh, 0);
+            this->visitedHigh = 0;
+            if (this->visited.size() < words)
+                this->visited.resize(words, 0);
+            this->memoBase = from;
+        }
+        for (const char *pos = from; pos < endOfStr && pos <= lastStart; pos++)
+        {
+            // skip the positions no match can start at
+            pos = this->prog.nextStart(startOfStr, pos, endOfStr);
+            if (!pos || pos > lastStart)
+                break;
+            slots.assign(this->prog.slots, NULL);
+            int res;
+            if (this->profile)
+            {
+                this->profile->starts++;
+                res = this->run<true>(this->prog.start, pos, endOfStr, false, slots);
+            }
+            else
+                res = this->run<false>(this->prog.start, pos, endOfStr, false, slots);
+            if (res != NoMatch)
+            {
+                this->stack.clear();
+                return res;
+            }
+        }
+        return NoMatch;
+    }
+
+} // namespace ft
@@ -0,0 +1,206 @@
+#include <RegexCache.hpp>
+#include <stdexcept>
+
+namespace ft
+{
+    // Start entry_t
+    RegexCache::entry_t::entry_t(Regex *regex, pattern_t const& key) :
+        regex(regex), key(key), refs(1) {}
+
+    RegexCache::entry_t::~entry_t()
+    {
+        delete this->regex;
+    }
+    // END entry_t
+
+    // Start Handle
+    RegexCache::Handle::Handle() : entry(NULL) {}
+
+    // takes a reference already counted for it
+    RegexCache::Handle::Handle(entry_t *entry) : entry(entry) {}
+
+    RegexCache::Handle::Handle(Handle const& other) : entry(other.entry)
+    {
+        if (this->entry)
+            __sync_add_and_fetch(&this->entry->refs, 1);
+    }
+
+    RegexCache::Handle  &RegexCache::Handle::operator=(Handle const& other)
+    {
+        if (other.entry)
+            __sync_add_and_fetch(&other.entry->refs, 1);
+        if (this->entry)
+            RegexCache::release(this->entry);
+        this->entry = other.entry;
+        return *this;
+    }
+
+    RegexCache::Handle::~Handle()
+    {
+        if (this->entry)
+            RegexCache::release(this->entry);
+    }
+
+    Regex const&    RegexCache::Handle::operator*() const
+    {
+        return *this->entry->regex;
+    }
+
+    Regex const*    RegexCache::Handle::operator->() const
+    {
+        return this->entry->regex;
+    }
+
+    Regex const*    RegexCache::Handle::get() const
+    {
+        return this->entry ? this->entry->regex : NULL;
+    }
+    // END Handle
+
+    RegexCache::RegexCache(size_t capacity) : capacity(capacity), hitCount(0),
+        missCount(0)
+    {
+        if (pthread_mutex_init(&this->lock, NULL))
+            throw std::runtime_error("RegexCache: pthread_mutex_init() failed");
+    }
+
+    RegexCache::~RegexCache()
+    {
+        this->clear();
+        pthread_mutex_destroy(&this->lock);
+    }
+
+    static RegexCache       *globalCache;
+    static pthread_once_t   globalOnce = PTHREAD_ONCE_INIT;
+
+    static void createGlobalCache()
+    {
+        globalCache = new RegexCache();
+    }
+
+    // never destroyed: handles may still be released by threads running
+    // while the process exits
+    RegexCache  &RegexCache::global()
+    {
+        pthread_once(&globalOnce, &createGlobalCache);
+        return *globalCache;
+    }
+
+    void    RegexCache::release(entry_t *entry)
+    {
+        if (__sync_sub_and_fetch(&entry->refs, 1) == 0)
+            delete entry;
+    }
+
+    // called with the lock held, the regexes themselves are deleted by
+    // the last release, possibly after the lock is released
+    void    RegexCache::evict(size_t keep)
+    {
+        while (this->lru.size() > keep)
+        {
+            entry_t *entry = this->lru.back();
+            this->lru.pop_back();
+            this->entries.erase(entry->key);
+            RegexCache::release(entry);
+        }
+    }
+
+    // The pattern is compiled without the lock so a miss does not hold up
+    // the other lookups; if another thread cached the same pattern
+    // meanwhile, its regex is used and this one is dropped
+    RegexCache::Handle  RegexCache::get(std::string const& pattern, unsigned int flags)
+    {
+        pattern_t   key(pattern, flags);
+        entry_t *entry;
+
+        pthread_mutex_lock(&this->lock);
+        map_t::iterator it = this->entries.find(key);
+        if (it != this->entries.end())
+        {
+            entry = it->second;
+            this->lru.splice(this->lru.begin(), this->lru, entry->lru);
+            __sync_add_and_fetch(&entry->refs, 1);
+            this->hitCount++;
+            pthread_mutex_unlock(&this->lock);
+            return Handle(entry);
+        }
+        this->missCount++;
+        pthread_mutex_unlock(&this->lock);
+
+        entry = new entry_t(NULL, key);
+        try
+        {
+            entry->regex = new Regex(pattern, flags);
+        }
+        catch (...)
+        {
+            delete entry;
+            throw;
+        }
+
+        pthread_mutex_lock(&this->lock);
+        it = this->entries.find(key);
+        if (it != this->entries.end())
+        {
+            delete entry;
+            entry = it->second;
+            this->lru.splice(this->lru.begin(), this->lru, entry->lru);
+        }
+        else if (this->capacity > 0)
+        {
+            this->lru.push_front(entry);
+            entry->lru = this->lru.begin();
+            this->entries.insert(std::make_pair(key, entry));
+            this->evict(this->capacity);
+        }
+        else
+        {
+            // nothing is cached, the handle owns the only reference
+            pthread_mutex_unlock(&this->lock);
+            return Handle(entry);
+        }
+        __sync_add_and_fetch(&entry->refs, 1);
+        pthread_mutex_unlock(&this->lock);
+        return Handle(entry);
+    }
+
+    size_t  RegexCache::hits() const
+    {
+        pthread_mutex_lock(&this->lock);
+        size_t  n = this->hitCount;
+        pthread_mutex_unlock(&this->lock);
+        return n;
+    }
+
+    size_t  RegexCache::misses() const
+    {
+        pthread_mutex_lock(&this->lock);
+        size_t  n = this->missCount;
+        pthread_mutex_unlock(&this->lock);
+        return n;
+    }
+
+    size_t  RegexCache::size() const
+    {
+        pthread_mutex_lock(&this->lock);
+        size_t  n = this->lru.size();
+        pthread_mutex_unlock(&this->lock);
+        return n;
+    }
+
+    void    RegexCache::setCapacity(size_t capacity)
+    {
+        pthread_mutex_lock(&this->lock);
+        this->capacity = capacity;
+        this->evict(capacity);
+        pthread_mutex_unlock(&this->lock);
+    }
+
+    void    RegexCache::clear()
+    {
+        pthread_mutex_lock(&this->lock);
+        this->evict(0);
+        pthread_mutex_unlock(&this->lock);
+    }
+
+} // namespace ft
@@ -0,0 +1,430 @@
+#include <RegexProgram.hpp>
+#include <algorithm>
+
+namespace ft
+{
+    RegexLazyDFA::State::State(std::vector<int> const& pcs, int context) :
+        pcs(pcs), context(context), matchOnEnd(false), endComputed(false)
+    {
+        for (int i = 0; i < 256; i++)
+            this->next[i] = NULL;
+    }
+
+    RegexLazyDFA::RegexLazyDFA(RegexProgram const& prog, size_t budget) :
+        prog(prog), budget(budget), used(0), start(NULL), resets(0),
+        scanned(0), scannedAtReset(0), seen(prog.insts.size(), 0), generation(0),
+        mayGiveUp(true)
+    {
+        for (int i = 0; i < 4; i++)
+            this->idle[i] = NULL;
+    }
+
+    RegexLazyDFA::Cursor::Cursor() : context(AfterNewLine), offset(0) {}
+
+    RegexLazyDFA::~RegexLazyDFA()
+    {
+        this->reset();
+    }
+
+    bool    RegexLazyDFA::eligible(RegexProgram const *prog)
+    {
+        return prog && !prog->hasBackReference && !prog->hasLookAround
+            && !prog->hasContextualExits && prog->counters.empty();
+    }
+
+    void    RegexLazyDFA::setBudget(size_t budget)
+    {
+        this->budget = budget;
+        if (this->used > budget)
+            this->reset();
+    }
+
+    void    RegexLazyDFA::reset()
+    {
+        for (cache_t::iterator it = this->cache.begin(); it != this->cache.end(); ++it)
+            delete it->second;
+        this->cache.clear();
+        this->used = 0;
+        this->start = NULL;
+        for (int i = 0; i < 4; i++)
+            this->idle[i] = NULL;
+        this->resets++;
+    }
+
+    // returns NULL when the cache is full again too soon after the last
+    // flush, the DFA is then slower than the NFA would be. A stream has no
+    // NFA to fall back to, its cache is flushed anyway
+    RegexLazyDFA::State *RegexLazyDFA::lookup(std::vector<int> const& pcs, int context)
+    {
+        this->key = pcs;
+        this->key.push_back(context);
+        cache_t::iterator   it = this->cache.find(this->key);
+        if (it != this->cache.end())
+            return it->second;
+
+        size_t  cost = sizeof(State) + 2 * this->key.size() * sizeof(int)
+            + 4 * sizeof(void *);
+        if (this->used + cost > this->budget && !this->cache.empty())
+        {
+            if (this->mayGiveUp
+                && this->scanned - this->scannedAtReset < 10 * this->cache.size())
+                return NULL;
+            this->reset();
+            this->scannedAtReset = this->scanned;
+        }
+        State   *state = new State(pcs, context);
+        this->cache[this->key] = state;
+        this->used += cost;
+        return state;
+    }
+
+    // Runs the NFA threads of s over the byte c (or the end of the text):
+    // instructions that do not consume are followed, a thread is started
+    // at this position too, and the threads that accept c make the next state
+    RegexLazyDFA::State *RegexLazyDFA::step(State *s, int c, bool &matched)
+    {
+        std::vector<int>    next;
+        bool                nextIsWord = c != EndOfText && CharClass::word().has(c);
+
+        if (++this->generation == 0)
+        {
+            std::fill(this->seen.begin(), this->seen.end(), 0);
+            this->generation = 1;
+        }
+        matched = false;
+        this->matches.clear();
+        // read backwards, the end of the text is the start of the input
+        // where a match can start too
+        this->stack = s->pcs;
+        if (c != EndOfText || this->prog.reverse)
+            this->stack.push_back(this->prog.start);
+        while (!this->stack.empty())
+        {
+            int pc = this->stack.back();
+            this->stack.pop_back();
+            if (this->seen[pc] == this->generation)
+                continue;
+            this->seen[pc] = this->generation;
+
+            RegexInst const& inst = this->prog.insts[pc];
+            switch (inst.op)
+            {
+            case RegexInst::CHAR_CLASS:
+                if (c != EndOfText && this->prog.classes[inst.x].has(c))
+                    next.push_back(pc + 1);
+                break;
+            case RegexInst::MATCH:
+                matched = true;
+                // the patterns of a set that matched stay in the states
+                if (this->prog.set)
+                {
+                    next.push_back(pc);
+                    this->matches.push_back(inst.x);
+                }
+                break;
+            case RegexInst::JMP:
+                this->stack.push_back(inst.x);
+                break;
+            case RegexInst::SPLIT:
+                this->stack.push_back(inst.y);
+                this->stack.push_back(inst.x);
+                break;
+            case RegexInst::SAVE:
+            case RegexInst::MARK:
+                this->stack.push_back(pc + 1);
+                break;
+            case RegexInst::PROGRESS:
+                // whether the iteration was empty is not known here, both
+                // ways lead to the same set of positions unless the program
+                // hasContextualExits
+                this->stack.push_back(inst.y);
+                this->stack.push_back(pc + 1);
+                break;
+            case RegexInst::START_OF_LINE:
+                if (s->context & AfterNewLine)
+                    this->stack.push_back(pc + 1);
+                break;
+            case RegexInst::END_OF_LINE:
+                if (c == EndOfText || c == '\n')
+                    this->stack.push_back(pc + 1);
+                break;
+            case RegexInst::WORD_BOUNDARY:
+                if (((s->context & AfterWord) != 0) != nextIsWord)
+                    this->stack.push_back(pc + 1);
+                break;
+            case RegexInst::NON_WORD_BOUNDARY:
+                if (((s->context & AfterWord) != 0) == nextIsWord)
+                    this->stack.push_back(pc + 1);
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (c == EndOfText)
+        {
+            s->matchOnEnd = matched;
+            s->endComputed = true;
+            return s;
+        }
+        if (matched)
+            s->matchOn.add(c);
+        std::sort(next.begin(), next.end());
+        next.erase(std::unique(next.begin(), next.end()), next.end());
+
+        size_t  resets = this->resets;
+        State   *t = this->lookup(next, (c == '\n' ? AfterNewLine : 0)
+            | (nextIsWord ? AfterWord : 0));
+        // s is gone if the lookup flushed the cache
+        if (t && resets == this->resets)
+            s->next[c] = t;
+        return t;
+    }
+
+    // the state without threads after the byte before p (p > start of the input)
+    RegexLazyDFA::State *RegexLazyDFA::idleState(const char *p)
+    {
+        int context = (p[-1] == '\n' ? AfterNewLine : 0)
+            | (CharClass::word().has(static_cast<unsigned char>(p[-1])) ? AfterWord : 0);
+
+        if (!this->idle[context])
+            this->idle[context] = this->lookup(std::vector<int>(), context);
+        return this->idle[context];
+    }
+
+    int     RegexLazyDFA::search(const char *startOfStr, const char *from,
+        const char *endOfStr, const char **matchEnd)
+    {
+        size_t  base = this->scanned;
+        State   *s = this->start;
+        bool    matched = false;
+
+        if (!s)
+        {
+            s = this->lookup(std::vector<int>(), AfterNewLine);
+            if (!s)
+                return GaveUp;
+            this->start = s;
+        }
+        if (from != startOfStr)
+        {
+            s = this->idleState(from);
+            if (!s)
+                return GaveUp;
+        }
+        for (const char *p = from; p < endOfStr; p++)
+        {
+            // no thread is running, jump to where a match can start
+            if (s->pcs.empty() && this->prog.canSkip())
+            {
+                const char  *q = this->prog.nextStart(startOfStr, p, endOfStr);
+                if (!q)
+                    return NoMatch;
+                if (q != p)
+                {
+                    p = q;
+                    this->scanned = base + (p - from);
+                    s = this->idleState(p);
+                    if (!s)
+                        return GaveUp;
+                }
+            }
+
+            unsigned char   c = *p;
+            State           *t = s->next[c];
+
+            if (t)
+                matched = s->matchOn.has(c);
+            else
+            {
+                this->scanned = base + (p - from);
+                t = this->step(s, c, matched);
+                if (!t)
+                    return GaveUp;
+            }
+            if (matched)
+            {
+                if (matchEnd)
+                    *matchEnd = p;
+                return Match;
+            }
+            s = t;
+        }
+        this->scanned = base + (endOfStr - from);
+        if (!s->endComputed)
+            this->step(s, EndOfText, matched);
+        if (!s->matchOnEnd)
+            return NoMatch;
+        if (matchEnd)
+            *matchEnd = endOfStr;
+        return Match;
+    }
+
+    // A match ending before the last byte of a chunk is only found once
+    // the byte after it is read ($ and \b depend on it), by the next chunk
+    // or the end of the stream. The bytes no match can start with are
+    // skipped while no thread runs; the prefix is not looked for, it may
+    // straddle two chunks
+    void    RegexLazyDFA::scanStream(Cursor &cursor, const char *from, const char *end,
+        std::vector<unsigned long long> &ends)
+    {
+        size_t  base = this->scanned;
+        bool    matched = false;
+
+        this->mayGiveUp = false;
+        State   *s = this->lookup(cursor.pcs, cursor.context);
+        for (const char *p = from; p < end; p++)
+        {
+            if (s->pcs.empty() && !this->prog.anyFirst)
+            {
+                const char  *q = this->prog.scanFirst(p, end);
+                if (q != p)
+                {
+                    p = q ? q : end;
+                    s = this->idleState(p);
+                    if (!q)
+                        break;
+                }
+            }
+
+            unsigned char   c = *p;
+            State           *t = s->next[c];
+
+            if (t)
+                matched = s->matchOn.has(c);
+            else
+            {
+                this->scanned = base + (p - from);
+                t = this->step(s, c, matched);
+            }
+            if (matched)
+                ends.push_back(cursor.offset + (p - from));
+            s = t;
+        }
+        this->scanned = base + (end - from);
+        this->mayGiveUp = true;
+        cursor.pcs = s->pcs;
+        cursor.context = s->context;
+        cursor.offset += end - from;
+    }
+
+    void    RegexLazyDFA::endStream(Cursor &cursor, std::vector<unsigned long long> &ends)
+    {
+        bool    matched;
+
+        this->mayGiveUp = false;
+        State   *s = this->lookup(cursor.pcs, cursor.context);
+        this->mayGiveUp = true;
+        if (!s->endComputed)
+            this->step(s, EndOfText, matched);
+        if (s->matchOnEnd)
+            ends.push_back(cursor.offset);
+    }
+
+    // For a set program: reads the whole input, the patterns that matched
+    // are still in the state reached at its end. ids receives them
+    int     RegexLazyDFA::searchSet(const char *startOfStr, const char *endOfStr,
+        std::vector<int> &ids)
+    {
+        size_t  base = this->scanned;
+        State   *s = this->start;
+        bool    matched = false;
+
+        if (!s)
+        {
+            s = this->lookup(std::vector<int>(), AfterNewLine);
+            if (!s)
+                return GaveUp;
+            this->start = s;
+        }
+        for (const char *p = startOfStr; p < endOfStr; p++)
+        {
+            // nothing matched and no thread is running
+            if (s->pcs.empty() && this->prog.canSkip())
+            {
+                const char  *q = this->prog.nextStart(startOfStr, p, endOfStr);
+                if (!q)
+                {
+                    ids.clear();
+                    return NoMatch;
+                }
+                if (q != p)
+                {
+                    p = q;
+                    this->scanned = base + (p - startOfStr);
+                    s = this->idleState(p);
+                    if (!s)
+                        return GaveUp;
+                }
+            }
+
+            State   *t = s->next[static_cast<unsigned char>(*p)];
+            if (!t)
+            {
+                this->scanned = base + (p - startOfStr);
+                t = this->step(s, static_cast<unsigned char>(*p), matched);
+                if (!t)
+                    return GaveUp;
+            }
+            s = t;
+        }
+        this->scanned = base + (endOfStr - startOfStr);
+        this->step(s, EndOfText, matched);
+        ids = this->matches;
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        return ids.empty() ? NoMatch : Match;
+    }
+
+    // Runs a reverse program from the end of the input to its start, a
+    // match of the reversed string found after consuming the byte at p
+    // starts at p + 1 in the input. The whole input is read to find the
+    // leftmost one
+    int     RegexLazyDFA::searchReverse(const char *startOfStr, const char *endOfStr,
+        const char **leftmost)
+    {
+        size_t  base = this->scanned;
+        State   *s = this->start;
+        bool    matched = false;
+        int     res = NoMatch;
+
+        if (!s)
+        {
+            s = this->lookup(std::vector<int>(), AfterNewLine);
+            if (!s)
+                return GaveUp;
+            this->start = s;
+        }
+        for (const char *p = endOfStr; p > startOfStr; )
+        {
+            unsigned char   c = *--p;
+            State           *t = s->next[c];
+
+            if (t)
+                matched = s->matchOn.has(c);
+            else
+            {
+                this->scanned = base + (endOfStr - p);
+                t = this->step(s, c, matched);
+                if (!t)
+                    return GaveUp;
+            }
+            if (matched)
+            {
+                *leftmost = p + 1;
+                res = Match;
+            }
+            s = t;
+        }
+        this->scanned = base + (endOfStr - startOfStr);
+        if (!s->endComputed)
+            this->step(s, EndOfText, matched);
+        if (s->matchOnEnd)
+        {
+            *leftmost = startOfStr;
+            res = Match;
+        }
+        return res;
+    }
+
+} // namespace ft
@@ -0,0 +1,502 @@
+#include <RegexImage.hpp>
+#include <stdint.h>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ft
+{
+    // The file holds the header, one ImageRegex per regex, then the
+    // programs with their tables. Offsets count from the start of the
+    // file and every record starts on a multiple of Alignment, so the
+    // tables can be read in place from the mapping
+    static const char       Magic[4] = {'f', 't', 'R', 'x'};
+    static const uint32_t   ByteOrder = 0x01020304;
+    static const size_t     Alignment = 8;
+
+    struct ImageHeader
+    {
+        char        magic[4];
+        uint32_t    version;
+        uint32_t    byteOrder;      // ByteOrder as written
+        uint32_t    regexes;
+        uint64_t    size;           // of the whole file
+        uint64_t    set;            // offset of the ImageSet, 0 without one
+    };
+
+    struct ImageRegex
+    {
+        uint64_t    pattern;
+        uint64_t    patternSize;
+        uint64_t    program;
+        uint64_t    reverseProgram; // 0 without one
+        uint32_t    flags;
+        uint32_t    padding;
+    };
+
+    struct ImageSet
+    {
+        uint64_t    program;        // 0 when no pattern was combined
+        uint64_t    combined;       // uint32_t ids
+        uint64_t    combinedSize;
+        uint64_t    others;
+        uint64_t    othersSize;
+    };
+
+    struct ImageProgram
+    {
+        enum
+        {
+            HasBackReference = 1,
+            HasLookAround = 2,
+            Reverse = 4,
+            Set = 8,
+            AnyFirst = 16,
+            AnchoredStart = 32,
+            AnchoredEnd = 64,
+            HasContextualExits = 128,
+        };
+
+        uint64_t        insts;
+        uint64_t        instsSize;
+        uint64_t        classes;
+        uint64_t        classesSize;
+        uint64_t        counters;
+        uint64_t        countersSize;
+        uint64_t        prefix;
+        uint64_t        prefixSize;
+        uint64_t        required;
+        uint64_t        requiredSize;
+        uint32_t        start;
+        uint32_t        groups;
+        uint32_t        slots;
+        uint32_t        options;
+        uint32_t        first[8];
+        uint32_t        firstRangesSize;
+        unsigned char   firstRanges[RegexProgram::MaxFirstRanges][2];
+    };
+
+    // Builds the bytes of an image, the records are appended zero padded
+    // and the fixed ones patched once their offsets are known
+    class ImageWriter
+    {
+        std::string     bytes;
+
+    public:
+        size_t  reserve(size_t size)
+        {
+            this->bytes.resize((this->bytes.size() + Alignment - 1) / Alignment * Alignment);
+            size_t  offset = this->bytes.size();
+            this->bytes.resize(offset + size);
+            return offset;
+        }
+
+        size_t  append(const void *data, size_t size)
+        {
+            size_t  offset = this->reserve(size);
+            if (size)
+                std::memcpy(&this->bytes[offset], data, size);
+            return offset;
+        }
+
+        void    put(size_t offset, const void *data, size_t size)
+        {
+            std::memcpy(&this->bytes[offset], data, size);
+        }
+
+        std::string const&  str() const
+        {
+            return this->bytes;
+        }
+    };
+
+    static size_t   writeProgram(ImageWriter &out, RegexProgram const& prog)
+    {
+        ImageProgram    p;
+
+        std::memset(&p, 0, sizeof(p));
+        p.insts = out.append(prog.insts.data(), prog.insts.size() * sizeof(RegexInst));
+        p.instsSize = prog.insts.size();
+        p.classes = out.append(prog.classes.data(), prog.classes.size() * sizeof(CharClass));
+        p.classesSize = prog.classes.size();
+        p.counters = out.append(prog.counters.data(),
+            prog.counters.size() * sizeof(prog.counters[0]));
+        p.countersSize = prog.counters.size();
+        p.prefix = out.append(prog.prefix.data(), prog.prefix.size());
+        p.prefixSize = prog.prefix.size();
+        p.required = out.append(prog.required.data(), prog.required.size());
+        p.requiredSize = prog.required.size();
+        p.start = prog.start;
+        p.groups = prog.groups;
+        p.slots = prog.slots;
+        p.options = (prog.hasBackReference ? ImageProgram::HasBackReference : 0)
+            | (prog.hasLookAround ? ImageProgram::HasLookAround : 0)
+            | (prog.hasContextualExits ? ImageProgram::HasContextualExits : 0)
+            | (prog.reverse ? ImageProgram::Reverse : 0)
+            | (prog.set ? ImageProgram::Set : 0)
+            | (prog.anyFirst ? ImageProgram::AnyFirst : 0)
+            | (prog.anchoredStart ? ImageProgram::AnchoredStart : 0)
+            | (prog.anchoredEnd ? ImageProgram::AnchoredEnd : 0);
+        std::memcpy(p.first, prog.first.bits, sizeof(p.first));
+        p.firstRangesSize = prog.firstRanges.size();
+        for (size_t i = 0; i < prog.firstRanges.size(); i++)
+        {
+            p.firstRanges[i][0] = prog.firstRanges[i].first;
+            p.firstRanges[i][1] = prog.firstRanges[i].second;
+        }
+        return out.append(&p, sizeof(p));
+    }
+
+    // the operands of every instruction are in range, so a damaged file
+    // cannot make the matchers read outside the program
+    static bool     validProgram(RegexProgram const& prog)
+    {
+        int     size = prog.insts.size();
+
+        if (!size || prog.start < 0 || prog.start >= size
+            || prog.insts[size - 1].op != RegexInst::MATCH
+            || prog.slots < 2 * prog.groups)
+            return false;
+        for (int pc = 0; pc < size; pc++)
+        {
+            RegexInst const&    inst = prog.insts[pc];
+            bool                ok;
+
+            switch (inst.op)
+            {
+            case RegexInst::CHAR_CLASS:
+                ok = inst.x >= 0 && static_cast<size_t>(inst.x) < prog.classes.size();
+                break;
+            case RegexInst::SPLIT:
+                ok = inst.x >= 0 && inst.x < size && inst.y >= 0 && inst.y < size;
+                break;
+            case RegexInst::JMP:
+            case RegexInst::LOOK_AHEAD:
+            case RegexInst::NEGATIVE_LOOK_AHEAD:
+            case RegexInst::LOOK_BEHIND:
+            case RegexInst::NEGATIVE_LOOK_BEHIND:
+                ok = inst.x >= 0 && inst.x < size;
+                break;
+            case RegexInst::SAVE:
+            case RegexInst::MARK:
+                ok = inst.x >= 0 && static_cast<size_t>(inst.x) < prog.slots;
+                break;
+            case RegexInst::PROGRESS:
+                ok = inst.x >= 0 && static_cast<size_t>(inst.x) < prog.slots
+                    && inst.y >= 0 && inst.y < size;
+                break;
+            case RegexInst::BACK_REFERENCE:
+                ok = inst.x >= 0 && static_cast<size_t>(inst.x) < prog.groups;
+                break;
+            case RegexInst::REPEAT_START:
+                ok = inst.x >= 0 && static_cast<size_t>(inst.x) < prog.counters.size();
+                break;
+            case RegexInst::REPEAT:
+            case RegexInst::COUNT:
+                ok = inst.x >= 0 && static_cast<size_t>(inst.x) < prog.counters.size()
+                    && inst.y >= 0 && inst.y < size;
+                break;
+            case RegexInst::START_OF_LINE:
+            case RegexInst::END_OF_LINE:
+            case RegexInst::WORD_BOUNDARY:
+            case RegexInst::NON_WORD_BOUNDARY:
+            case RegexInst::MATCH:
+                ok = true;
+                break;
+            default:
+                ok = false;
+                break;
+            }
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+
+    RegexImage::InvalidImageException::InvalidImageException(const char* error) :
+        error(error) {}
+
+    const char* RegexImage::InvalidImageException::what() const throw()
+    {
+        return error;
+    }
+
+    RegexImage::RegexImage(std::string const& path) : data(NULL), length(0),
+        loadedSet(NULL)
+    {
+        int         fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+
+        if (fd < 0)
+            throw std::runtime_error("RegexImage: cannot open " + path);
+        if (fstat(fd, &st) < 0)
+        {
+            close(fd);
+            throw std::runtime_error("RegexImage: cannot stat " + path);
+        }
+        if (static_cast<size_t>(st.st_size) < sizeof(ImageHeader))
+        {
+            close(fd);
+            throw InvalidImageException("RegexImage: not a regex image");
+        }
+        void    *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+            throw std::runtime_error("RegexImage: cannot map " + path);
+        this->data = static_cast<const char *>(map);
+        this->length = st.st_size;
+        try
+        {
+            this->load();
+        }
+        catch (...)
+        {
+            this->release();
+            throw;
+        }
+    }
+
+    RegexImage::~RegexImage()
+    {
+        this->release();
+    }
+
+    void    RegexImage::release()
+    {
+        if (this->loadedSet)
+            delete this->loadedSet;
+        else
+            for (size_t i = 0; i < this->regexes.size(); i++)
+                delete this->regexes[i];
+        this->regexes.clear();
+        this->loadedSet = NULL;
+        if (this->data)
+            munmap(const_cast<char *>(this->data), this->length);
+        this->data = NULL;
+    }
+
+    // count records of T at offset, which must lie in the file
+    template<class T>
+    T const     *RegexImage::at(size_t offset, size_t count) const
+    {
+        if (offset % Alignment || offset > this->length
+            || count > (this->length - offset) / sizeof(T))
+            throw InvalidImageException("RegexImage: truncated or damaged image");
+        return reinterpret_cast<T const *>(this->data + offset);
+    }
+
+    RegexProgram    *RegexImage::loadProgram(size_t offset) const
+    {
+        ImageProgram const  *p = this->at<ImageProgram>(offset);
+        RegexProgram        *prog = new RegexProgram();
+
+        try
+        {
+            prog->insts.map(this->at<RegexInst>(p->insts, p->instsSize), p->instsSize);
+            prog->classes.map(this->at<CharClass>(p->classes, p->classesSize),
+                p->classesSize);
+            prog->counters.map(this->at<std::pair<int, int> >(p->counters,
+                p->countersSize), p->countersSize);
+            prog->prefix.assign(this->at<char>(p->prefix, p->prefixSize), p->prefixSize);
+            prog->required.assign(this->at<char>(p->required, p->requiredSize),
+                p->requiredSize);
+            prog->start = p->start;
+            prog->groups = p->groups;
+            prog->slots = p->slots;
+            prog->hasBackReference = p->options & ImageProgram::HasBackReference;
+            prog->hasLookAround = p->options & ImageProgram::HasLookAround;
+            prog->hasContextualExits = p->options & ImageProgram::HasContextualExits;
+            prog->reverse = p->options & ImageProgram::Reverse;
+            prog->set = p->options & ImageProgram::Set;
+            prog->anyFirst = p->options & ImageProgram::AnyFirst;
+            prog->anchoredStart = p->options & ImageProgram::AnchoredStart;
+            prog->anchoredEnd = p->options & ImageProgram::AnchoredEnd;
+            std::memcpy(prog->first.bits, p->first, sizeof(p->first));
+            if (p->firstRangesSize > RegexProgram::MaxFirstRanges)
+                throw InvalidImageException("RegexImage: damaged program");
+            for (size_t i = 0; i < p->firstRangesSize; i++)
+                prog->firstRanges.push_back(std::make_pair(p->firstRanges[i][0],
+                    p->firstRanges[i][1]));
+            if (!validProgram(*prog))
+                throw InvalidImageException("RegexImage: damaged program");
+        }
+        catch (...)
+        {
+            delete prog;
+            throw;
+        }
+        return prog;
+    }
+
+    void    RegexImage::load()
+    {
+        ImageHeader const   *header = this->at<ImageHeader>(0);
+
+        if (std::memcmp(header->magic, Magic, sizeof(Magic)))
+            throw InvalidImageException("RegexImage: not a regex image");
+        if (header->byteOrder != ByteOrder)
+            throw InvalidImageException("RegexImage: image written with another byte order");
+        if (header->version != Version)
+            throw InvalidImageException("RegexImage: unsupported image version");
+        if (header->size != this->length)
+            throw InvalidImageException("RegexImage: truncated or damaged image");
+
+        ImageRegex const    *records = this->at<ImageRegex>(sizeof(ImageHeader),
+            header->regexes);
+        this->regexes.reserve(header->regexes);
+        for (size_t i = 0; i < header->regexes; i++)
+        {
+            ImageRegex const&   r = records[i];
+            std::string         pattern(this->at<char>(r.pattern, r.patternSize),
+                r.patternSize);
+            RegexProgram        *program = this->loadProgram(r.program);
+            RegexProgram        *reverse = NULL;
+
+            try
+            {
+                if (program->reverse || program->set || !program->groups)
+                    throw InvalidImageException("RegexImage: damaged program");
+                if (r.reverseProgram)
+                    reverse = this->loadProgram(r.reverseProgram);
+                if (reverse && !reverse->reverse)
+                    throw InvalidImageException("RegexImage: damaged program");
+                this->regexes.push_back(new Regex(pattern, r.flags, program, reverse));
+            }
+            catch (...)
+            {
+                delete program;
+                delete reverse;
+                throw;
+            }
+        }
+        if (!header->set)
+            return;
+
+        ImageSet const  *set = this->at<ImageSet>(header->set);
+        uint32_t const  *combined = this->at<uint32_t>(set->combined, set->combinedSize);
+        uint32_t const  *others = this->at<uint32_t>(set->others, set->othersSize);
+
+        // from now on the set owns the regexes
+        this->loadedSet = new RegexSet();
+        this->loadedSet->regexes = this->regexes;
+        for (size_t i = 0; i < set->combinedSize; i++)
+            this->loadedSet->combined.push_back(combined[i]);
+        for (size_t i = 0; i < set->othersSize; i++)
+            this->loadedSet->others.push_back(others[i]);
+        for (size_t i = 0; i < set->combinedSize + set->othersSize; i++)
+        {
+            size_t  id = i < set->combinedSize ? combined[i] : others[i - set->combinedSize];
+            if (id >= this->regexes.size())
+                throw InvalidImageException("RegexImage: damaged set");
+        }
+        if (set->program)
+        {
+            this->loadedSet->program = this->loadProgram(set->program);
+            if (!this->loadedSet->program->set)
+                throw InvalidImageException("RegexImage: damaged set");
+        }
+    }
+
+    // The image is written next to path then renamed over it: the
+    // processes that mapped the previous file keep reading it unchanged
+    void    RegexImage::save(std::string const& path,
+        std::vector<Regex const *> const& regexes, RegexSet const *set)
+    {
+        ImageWriter     out;
+        ImageHeader     header;
+        size_t          records;
+        size_t          setRecord = 0;
+
+        std::memset(&header, 0, sizeof(header));
+        out.reserve(sizeof(header));
+        records = out.reserve(regexes.size() * sizeof(ImageRegex));
+        if (set)
+            setRecord = out.reserve(sizeof(ImageSet));
+        for (size_t i = 0; i < regexes.size(); i++)
+        {
+            ImageRegex  r;
+
+            std::memset(&r, 0, sizeof(r));
+            r.pattern = out.append(regexes[i]->regex.data(), regexes[i]->regex.size());
+            r.patternSize = regexes[i]->regex.size();
+            r.program = writeProgram(out, *regexes[i]->program);
+            if (regexes[i]->reverseProgram)
+                r.reverseProgram = writeProgram(out, *regexes[i]->reverseProgram);
+            r.flags = regexes[i]->flags;
+            out.put(records + i * sizeof(ImageRegex), &r, sizeof(r));
+        }
+        if (set)
+        {
+            ImageSet                s;
+            std::vector<uint32_t>   combined(set->combined.begin(), set->combined.end());
+            std::vector<uint32_t>   others(set->others.begin(), set->others.end());
+
+            std::memset(&s, 0, sizeof(s));
+            if (set->program)
+                s.program = writeProgram(out, *set->program);
+            s.combined = out.append(combined.empty() ? NULL : &combined[0],
+                combined.size() * sizeof(uint32_t));
+            s.combinedSize = combined.size();
+            s.others = out.append(others.empty() ? NULL : &others[0],
+                others.size() * sizeof(uint32_t));
+            s.othersSize = others.size();
+            out.put(setRecord, &s, sizeof(s));
+        }
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.byteOrder = ByteOrder;
+        header.regexes = regexes.size();
+        header.size = out.str().size();
+        header.set = setRecord;
+        out.put(0, &header, sizeof(header));
+
+        std::string     tmp = path + ".tmp";
+        std::ofstream   file(tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(out.str().data(), out.str().size());
+        file.close();
+        if (!file || std::rename(tmp.c_str(), path.c_str()))
+        {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("RegexImage: cannot write " + path);
+        }
+    }
+
+    void    RegexImage::write(std::string const& path,
+        std::vector<Regex const *> const& regexes)
+    {
+        RegexImage::save(path, regexes, NULL);
+    }
+
+    void    RegexImage::write(std::string const& path, RegexSet const& set)
+    {
+        if (set.combined.size() + set.others.size() != set.regexes.size())
+            throw std::logic_error("RegexImage: the set must be compiled before it is written");
+        RegexImage::save(path, std::vector<Regex const *>(set.regexes.begin(),
+            set.regexes.end()), &set);
+    }
+
+    size_t  RegexImage::size() const
+    {
+        return this->regexes.size();
+    }
+
+    Regex   &RegexImage::operator[](size_t id)
+    {
+        return *this->regexes[id];
+    }
+
+    Regex const&    RegexImage::operator[](size_t id) const
+    {
+        return *this->regexes[id];
+    }
+
+    RegexSet const  *RegexImage::set() const
+    {
+        return this->loadedSet;
+    }
+
+} // namespace ft
@@ -0,0 +1,294 @@
+#include <RegexProgram.hpp>
+#include <algorithm>
+
+namespace ft
+{
+    // Start ThreadList
+    RegexPikeVM::ThreadList::ThreadList(size_t states) :
+        seen(states, 0), generation(1), size(0) {}
+
+    bool    RegexPikeVM::ThreadList::visit(int state)
+    {
+        if (this->seen[state] == this->generation)
+            return false;
+        this->seen[state] = this->generation;
+        return true;
+    }
+
+    void    RegexPikeVM::ThreadList::push(int pc, std::vector<const char *> const& cap)
+    {
+        if (this->pcs.size() == this->size)
+        {
+            this->pcs.resize(this->size + 1);
+            this->caps.resize((this->size + 1) * cap.size());
+        }
+        this->pcs[this->size] = pc;
+        std::copy(cap.begin(), cap.end(), this->caps.begin() + this->size * cap.size());
+        this->size++;
+    }
+
+    void    RegexPikeVM::ThreadList::clear()
+    {
+        this->size = 0;
+        if (++this->generation == 0)
+        {
+            std::fill(this->seen.begin(), this->seen.end(), 0);
+            this->generation = 1;
+        }
+    }
+    // END ThreadList
+
+    static bool isWordChar(const char *ptr, const char *startOfStr, const char *endOfStr)
+    {
+        return ptr >= startOfStr && ptr < endOfStr
+            && CharClass::word().has(static_cast<unsigned char>(*ptr));
+    }
+
+    RegexPikeVM::RegexPikeVM(RegexProgram const& prog, const char *startOfStr,
+        const char *endOfStr) : prog(prog), startOfStr(startOfStr),
+        endOfStr(endOfStr), clist(states(prog, loopMarks, firstState)),
+        nlist(clist.seen.size()), sub(NULL) {}
+
+    RegexPikeVM::~RegexPikeVM()
+    {
+        delete this->sub;
+    }
+
+    // the body of a loop is the instructions after its MARK up to its
+    // PROGRESS; without loops the state of a pc is the pc
+    size_t  RegexPikeVM::states(RegexProgram const& prog,
+        std::vector<std::vector<int> > &loopMarks, std::vector<int> &firstState)
+    {
+        for (size_t mark = 0; mark < prog.insts.size(); mark++)
+        {
+            if (prog.insts[mark].op != RegexInst::MARK)
+                continue;
+            if (loopMarks.empty())
+                loopMarks.resize(prog.insts.size());
+            size_t  pc = mark;
+            do
+                loopMarks[++pc].push_back(prog.insts[mark].x);
+            while (prog.insts[pc].op != RegexInst::PROGRESS
+                || prog.insts[pc].x != prog.insts[mark].x);
+        }
+        if (loopMarks.empty())
+            return prog.insts.size();
+        firstState.resize(prog.insts.size());
+        size_t  states = 0;
+        for (size_t pc = 0; pc < prog.insts.size(); pc++)
+        {
+            firstState[pc] = states;
+            states += loopMarks[pc].size() + 1;
+        }
+        return states;
+    }
+
+    int     RegexPikeVM::state(int pc, const char *pos) const
+    {
+        if (this->loopMarks.empty())
+            return pc;
+        std::vector<int> const& marks = this->loopMarks[pc];
+        size_t                  started = 0;
+
+        while (started < marks.size()
+            && this->cap[marks[marks.size() - 1 - started]] == pos)
+            started++;
+        return this->firstState[pc] + started;
+    }
+
+    void    RegexPikeVM::setInput(const char *startOfStr, const char *endOfStr)
+    {
+        this->startOfStr = startOfStr;
+        this->endOfStr = endOfStr;
+    }
+
+    // Follows every instruction that does not consume a character from pc,
+    // in priority order, and queues the threads that stop on CHAR_CLASS or
+    // MATCH. this->cap holds the captures of the thread being added
+    void    RegexPikeVM::addThread(ThreadList &list, int pc, const char *pos)
+    {
+        Job job;
+
+        job.pc = pc;
+        job.slot = -1;
+        this->jobs.push_back(job);
+        while (!this->jobs.empty())
+        {
+            job = this->jobs.back();
+            this->jobs.pop_back();
+            if (job.slot >= 0)
+            {
+                this->cap[job.slot] = job.value;
+                continue;
+            }
+            pc = job.pc;
+            while (pc >= 0 && list.visit(this->state(pc, pos)))
+            {
+                RegexInst const& inst = this->prog.insts[pc];
+                bool    word;
+                switch (inst.op)
+                {
+                case RegexInst::CHAR_CLASS:
+                case RegexInst::MATCH:
+                    list.push(pc, this->cap);
+                    pc = -1;
+                    break;
+                case RegexInst::JMP:
+                    pc = inst.x;
+                    break;
+                case RegexInst::SPLIT:
+                    job.pc = inst.y;
+                    job.slot = -1;
+                    this->jobs.push_back(job);
+                    pc = inst.x;
+                    break;
+                case RegexInst::SAVE:
+                case RegexInst::MARK:
+                    job.slot = inst.x;
+                    job.value = this->cap[inst.x];
+                    this->jobs.push_back(job);
+                    this->cap[inst.x] = pos;
+                    pc++;
+                    break;
+                case RegexInst::PROGRESS:
+                    pc = this->cap[inst.x] == pos ? inst.y : pc + 1;
+                    break;
+                case RegexInst::START_OF_LINE:
+                    pc = (pos == this->startOfStr || *(pos - 1) == '\n') ? pc + 1 : -1;
+                    break;
+                case RegexInst::END_OF_LINE:
+                    pc = (pos == this->endOfStr || *pos == '\n') ? pc + 1 : -1;
+                    break;
+                case RegexInst::WORD_BOUNDARY:
+                case RegexInst::NON_WORD_BOUNDARY:
+                    word = isWordChar(pos - 1, this->startOfStr, this->endOfStr)
+                        != isWordChar(pos, this->startOfStr, this->endOfStr);
+                    pc = (word == (inst.op == RegexInst::WORD_BOUNDARY)) ? pc + 1 : -1;
+                    break;
+                case RegexInst::LOOK_AHEAD:
+                case RegexInst::LOOK_BEHIND:
+                {
+                    std::vector<const char *>   &slots = this->subSlots;
+                    slots = this->cap;
+                    if (!this->lookAround(inst, pos, slots))
+                    {
+                        pc = -1;
+                        break;
+                    }
+                    for (size_t i = 0; i < slots.size(); i++)
+                    {
+                        if (slots[i] == this->cap[i])
+                            continue;
+                        job.slot = i;
+                        job.value = this->cap[i];
+                        this->jobs.push_back(job);
+                        this->cap[i] = slots[i];
+                    }
+                    pc++;
+                    break;
+                }
+                case RegexInst::NEGATIVE_LOOK_AHEAD:
+                case RegexInst::NEGATIVE_LOOK_BEHIND:
+                    this->subSlots = this->cap;
+                    pc = this->lookAround(inst, pos, this->subSlots) ? -1 : pc + 1;
+                    break;
+                default:
+                    pc = -1;
+                    break;
+                }
+            }
+        }
+    }
+
+    // the look-around body is matched by its own anchored run, a
+    // look-behind tries every width from the shortest one and must end at pos.
+    // The sub-run is kept for the next look-around, a nested one uses the
+    // sub-run of the sub-run
+    bool    RegexPikeVM::lookAround(RegexInst const& inst, const char *pos,
+        std::vector<const char *> &slots)
+    {
+        if (!this->sub)
+            this->sub = new RegexPikeVM(this->prog, this->startOfStr, this->endOfStr);
+        this->sub->setInput(this->startOfStr, this->endOfStr);
+        if (inst.op == RegexInst::LOOK_AHEAD
+            || inst.op == RegexInst::NEGATIVE_LOOK_AHEAD)
+            return this->sub->run(inst.x, pos, this->endOfStr, true, false, slots);
+        for (int width = inst.y; width <= inst.z; width++)
+        {
+            if (pos - this->startOfStr < width)
+                break;
+            if (this->sub->run(inst.x, pos - width, pos, true, true, slots))
+                return true;
+        }
+        return false;
+    }
+
+    bool    RegexPikeVM::run(int pc, const char *from, const char *stop,
+        bool anchored, bool mustEndAtStop, std::vector<const char *> &slots)
+    {
+        ThreadList                  *current = &this->clist;
+        ThreadList                  *next = &this->nlist;
+        size_t                      nslots = slots.size();
+        bool                        matched = false;
+
+        this->seed = slots;
+        current->clear();
+        for (const char *pos = from; ; pos++)
+        {
+            // no thread left, jump to where a match can start
+            if (!matched && !anchored && current->size == 0
+                && pc == this->prog.start)
+            {
+                const char  *skip = this->prog.nextStart(this->startOfStr, pos, stop);
+                if (!skip)
+                    break;
+                // the pcs seen at pos do not tell anything about skip
+                if (skip != pos)
+                    current->clear();
+                pos = skip;
+            }
+            if (!matched && (anchored ? pos == from : pos < stop))
+            {
+                this->cap = this->seed;
+                this->addThread(*current, pc, pos);
+            }
+            if (current->size == 0 && (matched || anchored || pos >= stop))
+                break;
+            next->clear();
+            for (size_t i = 0; i < current->size; i++)
+            {
+                RegexInst const&    inst = this->prog.insts[current->pcs[i]];
+                const char          **caps = &current->caps[i * nslots];
+
+                if (inst.op == RegexInst::MATCH)
+                {
+                    if (mustEndAtStop && pos != stop)
+                        continue;
+                    slots.assign(caps, caps + nslots);
+                    matched = true;
+                    break;
+                }
+                if (pos < stop && this->prog.classes[inst.x]
+                    .has(static_cast<unsigned char>(*pos)))
+                {
+                    this->cap.assign(caps, caps + nslots);
+                    this->addThread(*next, current->pcs[i] + 1, pos + 1);
+                }
+            }
+            std::swap(current, next);
+            if (pos >= stop)
+                break;
+        }
+        return matched;
+    }
+
+    bool    RegexPikeVM::search(const char *from, std::vector<const char *> &slots,
+        bool anchored)
+    {
+        slots.assign(this->prog.slots, NULL);
+        if (from >= this->endOfStr)
+            return false;
+        return this->run(this->prog.start, from, this->endOfStr, anchored, false, slots);
+    }
+
+} // namespace ft
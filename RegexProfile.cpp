@@ -0,0 +1,265 @@
+#include <Regex.hpp>
+#include <map>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace ft
+{
+    // Start profile_t
+
+    static const size_t MaxSpan = 60;      // longer spans are cut in dump()
+
+    void    Regex::profile_t::dump(std::ostream &out) const
+    {
+        static const char   *columns[] = { "entered", "succeeded", "failures",
+            "retries", "steps" };
+
+        for (size_t i = 0; i < sizeof(columns) / sizeof(*columns); i++)
+            out << std::setw(11) << columns[i];
+        out << "  component\n";
+        for (size_t i = 0; i < this->nodes.size(); i++)
+        {
+            node_t const&   node = this->nodes[i];
+            std::string     span = this->pattern.substr(node.begin, node.end - node.begin);
+
+            if (span.size() > MaxSpan)
+                span = span.substr(0, MaxSpan - 3) + "...";
+            out << std::setw(11) << node.entered << std::setw(11) << node.succeeded
+                << std::setw(11) << node.failures << std::setw(11) << node.retries
+                << std::setw(11) << node.steps << "  "
+                << std::string(2 * node.depth, ' ') << node.kind;
+            if (!span.empty())
+                out << "  " << span;
+            out << '\n';
+        }
+        out << this->starts << " start positions, "
+            << (this->result == Match ? "match" : this->result == NoMatch
+                ? "no match" : "aborted") << '\n';
+    }
+
+    // END profile_t
+
+    // Start profile
+
+    static std::string  describe(RegexComponentBase const *c)
+    {
+        std::ostringstream  out;
+
+        switch (c->type)
+        {
+        case RegexComponentBase::GROUP:
+        case RegexComponentBase::INVERSE_GROUP:
+            return "class";
+        case RegexComponentBase::CONCAT:
+            return "concat";
+        case RegexComponentBase::ALTERNATE:
+            return "alternate";
+        case RegexComponentBase::REPEAT:
+        case RegexComponentBase::LAZY_REPEAT:
+            if (c->type == RegexComponentBase::LAZY_REPEAT)
+                out << "lazy ";
+            out << "repeat {" << c->component.range->min << ',';
+            if (c->component.range->max != static_cast<unsigned long long>(__LONG_LONG_MAX__))
+                out << c->component.range->max;
+            out << '}';
+            return out.str();
+        case RegexComponentBase::START_OF_LINE:
+            return "start of line";
+        case RegexComponentBase::END_OF_LINE:
+            return "end of line";
+        case RegexComponentBase::START_OF_GROUP:
+            out << "open group " << static_cast<RegexStartOfGroup const *>(c)->id;
+            return out.str();
+        case RegexComponentBase::END_OF_GROUP:
+            out << "close group " << c->component.groupStart->id;
+            return out.str();
+        case RegexComponentBase::BACK_REFERENCE:
+            out << "back-reference " << c->component.groupStart->id;
+            return out.str();
+        case RegexComponentBase::WORD_BOUNDARY:
+            return "word boundary";
+        case RegexComponentBase::NON_WORD_BOUNDARY:
+            return "not a word boundary";
+        case RegexComponentBase::LOOK_AHEAD:
+            return "look-ahead";
+        case RegexComponentBase::NEGATIVE_LOOK_AHEAD:
+            return "negative look-ahead";
+        case RegexComponentBase::LOOK_BEHIND:
+            return "look-behind";
+        case RegexComponentBase::NEGATIVE_LOOK_BEHIND:
+            return "negative look-behind";
+        default:
+            return "component";
+        }
+    }
+
+    static bool holds(RegexOrigin const& origin, int pc)
+    {
+        return pc >= origin.first && pc < origin.end;
+    }
+
+    // The counts of the instructions are added up by component: a
+    // component is entered or left by the jumps from an instruction outside
+    // of it to one inside of it or the other way round. The body of a
+    // look-around is outside of the instructions of its look-around, the
+    // look-around enters it by jumping to x
+    struct RegexProfileTally
+    {
+        RegexProgram const&                 prog;
+        std::vector<RegexOrigin> const&     origins;
+        std::vector<int>                    innermost;  // origin of each pc, -1 for none
+        std::vector<size_t>                 node;       // node of each origin
+        std::vector<Regex::profile_t::node_t>   nodes;
+        std::vector<std::vector<size_t> >   children;
+        std::vector<size_t>                 roots;
+
+        RegexProfileTally(RegexProgram const& prog, std::vector<RegexOrigin> const& origins);
+        void    jumped(int from, int to, unsigned long long times, bool leaves = true);
+        void    add(RegexProfile const&);
+        void    flatten(size_t id, size_t depth, std::vector<Regex::profile_t::node_t> &out) const;
+    };
+
+    RegexProfileTally::RegexProfileTally(RegexProgram const& prog,
+        std::vector<RegexOrigin> const& origins) :
+        prog(prog), origins(origins), innermost(prog.insts.size(), -1),
+        node(origins.size())
+    {
+        std::map<RegexComponentBase const *, size_t>    ids;
+
+        // an origin comes after the one enclosing it
+        for (size_t i = 0; i < origins.size(); i++)
+        {
+            RegexOrigin const&  origin = origins[i];
+
+            for (int pc = origin.first; pc < origin.end; pc++)
+                this->innermost[pc] = i;
+            std::map<RegexComponentBase const *, size_t>::iterator  it
+                = ids.find(origin.component);
+            if (it != ids.end())
+            {
+                this->node[i] = it->second;
+                continue;
+            }
+            Regex::profile_t::node_t    n;
+            n.kind = describe(origin.component);
+            n.depth = 0;
+            n.begin = origin.component->begin;
+            n.end = origin.component->end;
+            n.entered = n.succeeded = n.failures = n.retries = n.steps = 0;
+            this->node[i] = this->nodes.size();
+            ids[origin.component] = this->nodes.size();
+            this->nodes.push_back(n);
+            this->children.push_back(std::vector<size_t>());
+            if (origin.parent < 0)
+                this->roots.push_back(this->node[i]);
+            else
+                this->children[this->node[origin.parent]].push_back(this->node[i]);
+        }
+    }
+
+    // a look-around running its body does not leave it
+    void    RegexProfileTally::jumped(int from, int to, unsigned long long times,
+        bool leaves)
+    {
+        if (!times)
+            return;
+        for (int o = this->innermost[from]; leaves && o >= 0 && holds(this->origins[o], from)
+            && !holds(this->origins[o], to); o = this->origins[o].parent)
+            this->nodes[this->node[o]].succeeded += times;
+        if (to >= static_cast<int>(this->innermost.size()))
+            return;
+        for (int o = this->innermost[to]; o >= 0 && holds(this->origins[o], to)
+            && !holds(this->origins[o], from); o = this->origins[o].parent)
+            this->nodes[this->node[o]].entered += times;
+    }
+
+    void    RegexProfileTally::add(RegexProfile const& profile)
+    {
+        for (int o = this->innermost[this->prog.start]; o >= 0
+            && holds(this->origins[o], this->prog.start); o = this->origins[o].parent)
+            this->nodes[this->node[o]].entered += profile.starts;
+        for (size_t pc = 0; pc < this->prog.insts.size(); pc++)
+        {
+            RegexProfile::Counts const& counts = profile.insts[pc];
+            RegexInst const&            inst = this->prog.insts[pc];
+
+            this->jumped(pc, pc + 1, counts.next);
+            this->jumped(pc, inst.x, counts.x, inst.op < RegexInst::LOOK_AHEAD
+                || inst.op > RegexInst::NEGATIVE_LOOK_BEHIND);
+            this->jumped(pc, inst.y, counts.y);
+            for (int o = this->innermost[pc]; o >= 0 && holds(this->origins[o], pc);
+                o = this->origins[o].parent)
+            {
+                this->nodes[this->node[o]].steps += counts.runs;
+                this->nodes[this->node[o]].failures += counts.fails;
+            }
+            if (this->innermost[pc] >= 0)
+                this->nodes[this->node[this->innermost[pc]]].retries += counts.resumed;
+        }
+    }
+
+    void    RegexProfileTally::flatten(size_t id, size_t depth,
+        std::vector<Regex::profile_t::node_t> &out) const
+    {
+        out.push_back(this->nodes[id]);
+        out.back().depth = depth;
+        for (size_t i = 0; i < this->children[id].size(); i++)
+            this->flatten(this->children[id][i], depth + 1, out);
+    }
+
+    // the program is compiled again from the components, the same way, to
+    // know where each instruction comes from; nothing of it is kept by the
+    // regex
+    int     Regex::profile(const char *data, size_t len, profile_t &p,
+        limit_t const& limit) const
+    {
+        if (!this->root)
+            throw std::logic_error("Regex: a regex loaded from an image cannot be profiled");
+
+        std::vector<RegexOrigin>    origins;
+        RegexProgram                *prog = RegexProgram::compile(this->root,
+            this->program->groups, false, &origins);
+        RegexProfile                counts;
+        int                         res;
+
+        if (!prog)
+            throw InvalidRegexException("Regex too large");
+        counts.insts.assign(prog->insts.size(), RegexProfile::Counts());
+        counts.starts = 0;
+        try
+        {
+            RegexBacktracker            backtracker(*prog, this->backtrackLimit,
+                this->memoLimit);
+            RegexBudget                 budget(limit.steps, limit.deadline.tv_sec
+                || limit.deadline.tv_usec ? &limit.deadline : NULL);
+            std::vector<const char *>   slots;
+
+            backtracker.setProfile(&counts);
+            res = backtracker.search(data, data + len, data, data + len, slots,
+                limit.steps || budget.timed ? &budget : NULL);
+
+            RegexProfileTally   tally(*prog, origins);
+            tally.add(counts);
+            p.pattern = this->regex;
+            p.nodes.clear();
+            for (size_t i = 0; i < tally.roots.size(); i++)
+                tally.flatten(tally.roots[i], 0, p.nodes);
+            p.starts = counts.starts;
+        }
+        catch (...)
+        {
+            delete prog;
+            throw;
+        }
+        delete prog;
+        if (res == RegexBacktracker::OutOfMemory)
+            throw BacktrackLimitException();
+        p.result = res == RegexBacktracker::Match ? Match
+            : res == RegexBacktracker::Aborted ? Aborted : NoMatch;
+        return p.result;
+    }
+
+    // END profile
+
+} // namespace ft
@@ -0,0 +1,933 @@
+#include <RegexProgram.hpp>
+#include <cstring>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+# include <immintrin.h>
+#endif
+
+namespace ft
+{
+    // RepeatedRange::max as set by the parser for '*', '+' and '{n,}'
+    static const unsigned long long Unbounded = __LONG_LONG_MAX__;
+
+    struct ProgramTooLarge {};
+    struct NotReversible {};
+
+    // Lowers a component tree into a RegexProgram, look-around bodies are
+    // compiled after the main program as sub-programs ending with MATCH
+    class RegexCompiler
+    {
+        RegexProgram                        &prog;
+        bool                                reverse;
+        bool                                counted;    // the repeats are not expanded
+        std::vector<std::pair<RegexComponentBase const *, int> >  lookArounds;
+        std::vector<RegexOrigin>            *origins;
+        int                                 current;    // origin being compiled
+        std::vector<int>                    lookOrigins;    // the origin of each look-around
+
+        int     emit(int op, int x = 0, int y = 0, int z = 0);
+        int     classIndex(CharClass const&);
+        void    compile(RegexComponentBase const *);
+        void    alternate(RegexChildren const&);
+        void    repeat(RepeatedRange const&, bool lazy);
+        void    iteration(RegexComponentBase const *, int mark, std::vector<int> &exits);
+        void    countedRepeat(RegexComponentBase const *, int min, int max, bool lazy,
+                    int mark, std::vector<int> &exits);
+        void    lookAround(RegexComponentBase const *, int op);
+        void    literalPrefix();
+        void    firstBytes();
+        bool    anchored(int assertion, bool toMatch) const;
+
+    public:
+        RegexCompiler(RegexProgram &prog, bool reverse, bool counted = false,
+            std::vector<RegexOrigin> *origins = NULL);
+        void    run(RegexComponentBase const *root);
+        void    combine(std::vector<RegexProgram const *> const& progs,
+                    std::vector<int> const& ids);
+    };
+
+    // true if the component can match without consuming any character
+    static bool nullable(RegexComponentBase const *c)
+    {
+        switch (c->type)
+        {
+        case RegexComponentBase::GROUP:
+        case RegexComponentBase::INVERSE_GROUP:
+            return false;
+        case RegexComponentBase::CONCAT:
+            for (size_t i = 0; i < c->component.children->size(); i++)
+                if (!nullable(c->component.children->at(i)))
+                    return false;
+            return true;
+        case RegexComponentBase::ALTERNATE:
+            for (size_t i = 0; i < c->component.children->size(); i++)
+                if (nullable(c->component.children->at(i)))
+                    return true;
+            return false;
+        case RegexComponentBase::REPEAT:
+        case RegexComponentBase::LAZY_REPEAT:
+            return c->component.range->min == 0
+                || nullable(c->component.range->child);
+        default:
+            return true;
+        }
+    }
+
+    // true if the component matches the empty string wherever it is tried,
+    // its empty matches do not depend on an assertion
+    static bool emptyAnywhere(RegexComponentBase const *c)
+    {
+        switch (c->type)
+        {
+        case RegexComponentBase::CONCAT:
+            for (size_t i = 0; i < c->component.children->size(); i++)
+                if (!emptyAnywhere(c->component.children->at(i)))
+                    return false;
+            return true;
+        case RegexComponentBase::ALTERNATE:
+            for (size_t i = 0; i < c->component.children->size(); i++)
+                if (emptyAnywhere(c->component.children->at(i)))
+                    return true;
+            return false;
+        case RegexComponentBase::REPEAT:
+        case RegexComponentBase::LAZY_REPEAT:
+            return c->component.range->min == 0
+                || emptyAnywhere(c->component.range->child);
+        case RegexComponentBase::START_OF_GROUP:
+        case RegexComponentBase::END_OF_GROUP:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // literals found in every match of a component
+    struct Literals
+    {
+        static const size_t MaxLength = 64;
+
+        bool            exact;      // the component only matches prefix
+        std::string     prefix;     // every match starts with it
+        std::string     suffix;     // every match ends with it
+        std::string     inner;      // every match contains it
+
+        Literals(bool exact = false) : exact(exact) {}
+
+        void    keep(std::string const& s)
+        {
+            if (s.size() > this->inner.size())
+                this->inner = s;
+        }
+
+        // an exact literal too long to be useful only keeps its ends
+        void    truncate()
+        {
+            if (this->prefix.size() <= MaxLength)
+                return;
+            this->exact = false;
+            this->suffix = this->prefix.substr(this->prefix.size() - MaxLength);
+            this->prefix.resize(MaxLength);
+            this->inner = this->prefix;
+        }
+    };
+
+    static Literals literals(RegexComponentBase const *c);
+
+    static Literals concatLiterals(RegexChildren const& children)
+    {
+        Literals    res(true);
+
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            Literals    next = literals(children[i]);
+
+            if (res.exact && next.exact)
+            {
+                res.prefix += next.prefix;
+                res.suffix = res.prefix;
+                res.keep(res.prefix);
+                res.truncate();
+                continue;
+            }
+            res.keep(next.inner);
+            res.keep(res.suffix + next.prefix);
+            if (res.exact)
+                res.prefix += next.prefix;
+            res.suffix = next.exact ? res.suffix + next.prefix : next.suffix;
+            res.exact = false;
+            res.keep(res.prefix);
+            res.keep(res.suffix);
+            if (res.suffix.size() > Literals::MaxLength)
+                res.suffix.erase(0, res.suffix.size() - Literals::MaxLength);
+        }
+        return res;
+    }
+
+    static Literals alternateLiterals(RegexChildren const& children)
+    {
+        Literals    res = literals(children[0]);
+
+        for (size_t i = 1; i < children.size(); i++)
+        {
+            Literals    next = literals(children[i]);
+            size_t      n = 0;
+
+            if (res.exact && next.exact && res.prefix == next.prefix)
+                continue;
+            while (n < res.prefix.size() && n < next.prefix.size()
+                && res.prefix[n] == next.prefix[n])
+                n++;
+            res.prefix.resize(n);
+            n = 0;
+            while (n < res.suffix.size() && n < next.suffix.size()
+                && res.suffix[res.suffix.size() - n - 1] == next.suffix[next.suffix.size() - n - 1])
+                n++;
+            res.suffix = res.suffix.substr(res.suffix.size() - n);
+            if (res.inner != next.inner)
+                res.inner.clear();
+            res.exact = false;
+        }
+        res.keep(res.prefix);
+        res.keep(res.suffix);
+        return res;
+    }
+
+    static Literals repeatLiterals(RepeatedRange const& range)
+    {
+        if (range.min == 0)
+            return Literals();
+
+        Literals    child = literals(range.child);
+
+        if (child.exact)
+        {
+            Literals    res(true);
+            for (unsigned long long i = 0; i < range.min
+                && res.prefix.size() <= Literals::MaxLength; i++)
+                res.prefix += child.prefix;
+            res.exact = range.min == range.max;
+            res.suffix = res.exact ? res.prefix : child.suffix;
+            res.keep(res.prefix);
+            res.truncate();
+            return res;
+        }
+        return child;
+    }
+
+    // a zero-width component is the exact empty string, the components
+    // not handled here match unknown strings
+    static Literals literals(RegexComponentBase const *c)
+    {
+        Literals    res;
+        int         chr;
+
+        switch (c->type)
+        {
+        case RegexComponentBase::GROUP:
+            chr = c->component.chars->single();
+            if (chr < 0)
+                break;
+            res.exact = true;
+            res.prefix = res.suffix = res.inner = std::string(1, chr);
+            break;
+        case RegexComponentBase::CONCAT:
+            return concatLiterals(*c->component.children);
+        case RegexComponentBase::ALTERNATE:
+            return alternateLiterals(*c->component.children);
+        case RegexComponentBase::REPEAT:
+        case RegexComponentBase::LAZY_REPEAT:
+            return repeatLiterals(*c->component.range);
+        case RegexComponentBase::START_OF_GROUP:
+        case RegexComponentBase::END_OF_GROUP:
+        case RegexComponentBase::START_OF_LINE:
+        case RegexComponentBase::END_OF_LINE:
+        case RegexComponentBase::WORD_BOUNDARY:
+        case RegexComponentBase::NON_WORD_BOUNDARY:
+        case RegexComponentBase::LOOK_AHEAD:
+        case RegexComponentBase::NEGATIVE_LOOK_AHEAD:
+        case RegexComponentBase::LOOK_BEHIND:
+        case RegexComponentBase::NEGATIVE_LOOK_BEHIND:
+            res.exact = true;
+            break;
+        default:
+            break;
+        }
+        return res;
+    }
+
+    RegexCompiler::RegexCompiler(RegexProgram &prog, bool reverse, bool counted,
+        std::vector<RegexOrigin> *origins) :
+        prog(prog), reverse(reverse), counted(counted), origins(origins), current(-1) {}
+
+    int     RegexCompiler::emit(int op, int x, int y, int z)
+    {
+        if (prog.insts.size() >= RegexProgram::MaxInstructions)
+            throw ProgramTooLarge();
+        RegexInst   inst;
+        inst.op = op;
+        inst.x = x;
+        inst.y = y;
+        inst.z = z;
+        prog.insts.push_back(inst);
+        return prog.insts.size() - 1;
+    }
+
+    int     RegexCompiler::classIndex(CharClass const& cls)
+    {
+        for (size_t i = 0; i < prog.classes.size(); i++)
+            if (!std::memcmp(prog.classes[i].bits, cls.bits, sizeof(cls.bits)))
+                return i;
+        prog.classes.push_back(cls);
+        return prog.classes.size() - 1;
+    }
+
+    void    RegexCompiler::run(RegexComponentBase const *root)
+    {
+        prog.start = 0;
+        compile(root);
+        emit(RegexInst::MATCH);
+        for (size_t i = 0; i < lookArounds.size(); i++)
+        {
+            prog.insts[lookArounds[i].second].x = prog.insts.size();
+            current = lookOrigins[i];
+            compile(lookArounds[i].first->component.range->child);
+            emit(RegexInst::MATCH);
+        }
+        if (reverse)
+        {
+            // the literals would be read backwards, nothing is skipped
+            prog.anyFirst = true;
+            return;
+        }
+        literalPrefix();
+        prog.required = literals(root).inner;
+        firstBytes();
+        prog.anchoredStart = anchored(RegexInst::START_OF_LINE, false);
+        prog.anchoredEnd = anchored(RegexInst::END_OF_LINE, true);
+    }
+
+    // A chain of SPLITs starts every program, each one is copied with its
+    // jumps, classes and slots moved after the ones of the previous ones
+    void    RegexCompiler::combine(std::vector<RegexProgram const *> const& progs,
+        std::vector<int> const& ids)
+    {
+        std::vector<int>    splits;
+
+        prog.start = 0;
+        for (size_t i = 0; i + 1 < progs.size(); i++)
+            splits.push_back(emit(RegexInst::SPLIT));
+        for (size_t i = 0; i < progs.size(); i++)
+        {
+            int     base = prog.insts.size();
+            int     classes = prog.classes.size();
+            int     slots = prog.slots;
+
+            if (i + 1 < progs.size())
+                prog.insts[splits[i]].x = base + progs[i]->start;
+            if (i > 0)
+                prog.insts[splits[i - 1]].y = i + 1 < progs.size() ? splits[i]
+                    : base + progs[i]->start;
+            for (size_t pc = 0; pc < progs[i]->insts.size(); pc++)
+            {
+                RegexInst   inst = progs[i]->insts[pc];
+                switch (inst.op)
+                {
+                case RegexInst::CHAR_CLASS:
+                    inst.x += classes;
+                    break;
+                case RegexInst::SPLIT:
+                    inst.x += base;
+                    inst.y += base;
+                    break;
+                case RegexInst::JMP:
+                    inst.x += base;
+                    break;
+                case RegexInst::SAVE:
+                case RegexInst::MARK:
+                    inst.x += slots;
+                    break;
+                case RegexInst::PROGRESS:
+                    inst.x += slots;
+                    inst.y += base;
+                    break;
+                case RegexInst::MATCH:
+                    inst.x = ids[i];
+                    break;
+                default:
+                    break;
+                }
+                emit(inst.op, inst.x, inst.y, inst.z);
+            }
+            for (size_t j = 0; j < progs[i]->classes.size(); j++)
+                prog.classes.push_back(progs[i]->classes[j]);
+            prog.slots += progs[i]->slots;
+        }
+        if (progs.size() == 1)
+            prog.start = progs[0]->start;
+        literalPrefix();
+        firstBytes();
+        prog.anchoredStart = anchored(RegexInst::START_OF_LINE, false);
+    }
+
+    // With toMatch false: true if every path from the start goes through
+    // the assertion before consuming anything.
+    // With toMatch true: true if on every path to MATCH the assertion comes
+    // after the last character consumed
+    bool    RegexCompiler::anchored(int assertion, bool toMatch) const
+    {
+        // a pc is visited once with the assertion pending and once after it
+        std::vector<bool>                   seen(2 * prog.insts.size(), false);
+        std::vector<std::pair<int, bool> >  stack(1, std::make_pair(prog.start, false));
+
+        while (!stack.empty())
+        {
+            int     pc = stack.back().first;
+            bool    passed = stack.back().second;
+            stack.pop_back();
+            if (seen[2 * pc + passed])
+                continue;
+            seen[2 * pc + passed] = true;
+
+            RegexInst const&    inst = prog.insts[pc];
+            if (inst.op == assertion)
+            {
+                if (!toMatch)
+                    continue;
+                passed = true;
+            }
+            switch (inst.op)
+            {
+            case RegexInst::CHAR_CLASS:
+            case RegexInst::BACK_REFERENCE:
+                if (!toMatch)
+                    return false;
+                stack.push_back(std::make_pair(pc + 1, false));
+                break;
+            case RegexInst::MATCH:
+                if (!passed)
+                    return false;
+                break;
+            case RegexInst::SPLIT:
+                stack.push_back(std::make_pair(inst.y, passed));
+                stack.push_back(std::make_pair(inst.x, passed));
+                break;
+            case RegexInst::JMP:
+                stack.push_back(std::make_pair(inst.x, passed));
+                break;
+            case RegexInst::PROGRESS:
+            case RegexInst::REPEAT:
+                stack.push_back(std::make_pair(inst.y, passed));
+                stack.push_back(std::make_pair(pc + 1, passed));
+                break;
+            case RegexInst::COUNT:
+                stack.push_back(std::make_pair(inst.y, passed));
+                break;
+            default:
+                stack.push_back(std::make_pair(pc + 1, passed));
+                break;
+            }
+        }
+        return true;
+    }
+
+    // the bytes the CHAR_CLASS reached from the start without consuming
+    // anything accept; if MATCH or a back-reference is reached first a
+    // match can start anywhere
+    void    RegexCompiler::firstBytes()
+    {
+        std::vector<bool>   seen(prog.insts.size(), false);
+        std::vector<int>    stack(1, prog.start);
+
+        while (!stack.empty() && !prog.anyFirst)
+        {
+            int pc = stack.back();
+            stack.pop_back();
+            if (seen[pc])
+                continue;
+            seen[pc] = true;
+
+            RegexInst const&    inst = prog.insts[pc];
+            switch (inst.op)
+            {
+            case RegexInst::CHAR_CLASS:
+                prog.first.addClass(prog.classes[inst.x]);
+                break;
+            case RegexInst::SPLIT:
+                stack.push_back(inst.y);
+                stack.push_back(inst.x);
+                break;
+            case RegexInst::JMP:
+                stack.push_back(inst.x);
+                break;
+            case RegexInst::PROGRESS:
+            case RegexInst::REPEAT:
+                stack.push_back(inst.y);
+                stack.push_back(pc + 1);
+                break;
+            case RegexInst::COUNT:
+                stack.push_back(inst.y);
+                break;
+            case RegexInst::MATCH:
+            case RegexInst::BACK_REFERENCE:
+                prog.anyFirst = true;
+                break;
+            default:
+                stack.push_back(pc + 1);
+                break;
+            }
+        }
+        if (prog.anyFirst)
+            return;
+
+        for (int c = 0; c < 256; c++)
+        {
+            if (!prog.first.has(c))
+                continue;
+            if (prog.firstRanges.empty() || c != prog.firstRanges.back().first
+                + prog.firstRanges.back().second + 1)
+                prog.firstRanges.push_back(std::make_pair(c, 0));
+            else
+                prog.firstRanges.back().second++;
+        }
+        if (prog.firstRanges.size() > RegexProgram::MaxFirstRanges)
+            prog.firstRanges.clear();
+        else if (prog.firstRanges.size() == 1 && prog.firstRanges[0].second == 255)
+            prog.anyFirst = true;
+    }
+
+    // the characters consumed before the first branch, when each of them
+    // can only be one byte; assertions do not consume anything and are
+    // skipped
+    void    RegexCompiler::literalPrefix()
+    {
+        for (int pc = prog.start; ; pc++)
+        {
+            RegexInst const&    inst = prog.insts[pc];
+            int                 c;
+
+            switch (inst.op)
+            {
+            case RegexInst::CHAR_CLASS:
+                c = prog.classes[inst.x].single();
+                if (c < 0)
+                    return;
+                prog.prefix += static_cast<char>(c);
+                break;
+            case RegexInst::SAVE:
+            case RegexInst::MARK:
+            case RegexInst::START_OF_LINE:
+            case RegexInst::END_OF_LINE:
+            case RegexInst::WORD_BOUNDARY:
+            case RegexInst::NON_WORD_BOUNDARY:
+            case RegexInst::LOOK_AHEAD:
+            case RegexInst::NEGATIVE_LOOK_AHEAD:
+            case RegexInst::LOOK_BEHIND:
+            case RegexInst::NEGATIVE_LOOK_BEHIND:
+                break;
+            default:
+                return;
+            }
+        }
+    }
+
+    void    RegexCompiler::compile(RegexComponentBase const *c)
+    {
+        int parent = current;
+
+        if (origins)
+        {
+            RegexOrigin origin = { c, parent, static_cast<int>(prog.insts.size()), 0 };
+            current = origins->size();
+            origins->push_back(origin);
+        }
+        switch (c->type)
+        {
+        case RegexComponentBase::GROUP:
+            emit(RegexInst::CHAR_CLASS, classIndex(*c->component.chars));
+            break;
+        case RegexComponentBase::INVERSE_GROUP:
+        {
+            CharClass   cls = *c->component.chars;
+            cls.invert();
+            emit(RegexInst::CHAR_CLASS, classIndex(cls));
+            break;
+        }
+        case RegexComponentBase::CONCAT:
+            for (size_t i = 0; i < c->component.children->size(); i++)
+                compile(c->component.children->at(reverse
+                    ? c->component.children->size() - i - 1 : i));
+            break;
+        case RegexComponentBase::ALTERNATE:
+            alternate(*c->component.children);
+            break;
+        case RegexComponentBase::REPEAT:
+            repeat(*c->component.range, false);
+            break;
+        case RegexComponentBase::LAZY_REPEAT:
+            repeat(*c->component.range, true);
+            break;
+        case RegexComponentBase::START_OF_GROUP:
+            if (!reverse)
+                emit(RegexInst::SAVE,
+                    2 * static_cast<RegexStartOfGroup const *>(c)->id);
+            break;
+        case RegexComponentBase::END_OF_GROUP:
+            if (!reverse)
+                emit(RegexInst::SAVE, 2 * c->component.groupStart->id + 1);
+            break;
+        case RegexComponentBase::START_OF_LINE:
+            emit(reverse ? RegexInst::END_OF_LINE : RegexInst::START_OF_LINE);
+            break;
+        case RegexComponentBase::END_OF_LINE:
+            emit(reverse ? RegexInst::START_OF_LINE : RegexInst::END_OF_LINE);
+            break;
+        case RegexComponentBase::WORD_BOUNDARY:
+            emit(RegexInst::WORD_BOUNDARY);
+            break;
+        case RegexComponentBase::NON_WORD_BOUNDARY:
+            emit(RegexInst::NON_WORD_BOUNDARY);
+            break;
+        case RegexComponentBase::BACK_REFERENCE:
+            if (reverse)
+                throw NotReversible();
+            prog.hasBackReference = true;
+            emit(RegexInst::BACK_REFERENCE, c->component.groupStart->id);
+            break;
+        case RegexComponentBase::LOOK_AHEAD:
+            lookAround(c, RegexInst::LOOK_AHEAD);
+            break;
+        case RegexComponentBase::NEGATIVE_LOOK_AHEAD:
+            lookAround(c, RegexInst::NEGATIVE_LOOK_AHEAD);
+            break;
+        case RegexComponentBase::LOOK_BEHIND:
+            lookAround(c, RegexInst::LOOK_BEHIND);
+            break;
+        case RegexComponentBase::NEGATIVE_LOOK_BEHIND:
+            lookAround(c, RegexInst::NEGATIVE_LOOK_BEHIND);
+            break;
+        default:
+            break;
+        }
+        if (origins)
+        {
+            (*origins)[current].end = prog.insts.size();
+            current = parent;
+        }
+    }
+
+    void    RegexCompiler::alternate(RegexChildren const& children)
+    {
+        std::vector<int>    jumps;
+
+        for (size_t i = 0; i + 1 < children.size(); i++)
+        {
+            int split = emit(RegexInst::SPLIT, prog.insts.size() + 1);
+            compile(children[i]);
+            jumps.push_back(emit(RegexInst::JMP));
+            prog.insts[split].y = prog.insts.size();
+        }
+        compile(children.back());
+        for (size_t i = 0; i < jumps.size(); i++)
+            prog.insts[jumps[i]].x = prog.insts.size();
+    }
+
+    // a{n,m} is expanded to n copies of a followed by m - n optional ones,
+    // an unbounded repeat loops on a single copy. Like RegexRepeat does
+    // with prev, a greedy repeat is left as soon as an iteration did not
+    // consume anything, the required ones included; like RegexRepeatLazy,
+    // a lazy one only leaves its loop early
+    void    RegexCompiler::repeat(RepeatedRange const& range, bool lazy)
+    {
+        std::vector<int>    splits;
+        std::vector<int>    exits;
+        bool                empty = nullable(range.child);
+        int                 mark = empty && (!lazy || range.max == Unbounded)
+            ? prog.slots++ : -1;
+        int                 copies = lazy ? -1 : mark;
+
+        // the DFA takes both ways out of a PROGRESS, it only matches the
+        // same strings if an empty copy could as well be the last one
+        if (copies >= 0 && !emptyAnywhere(range.child))
+            prog.hasContextualExits = true;
+        if (counted && (range.min > 1 || (range.max != Unbounded && range.max > 1)))
+        {
+            int min = range.min;
+            int max = range.max == Unbounded ? min : range.max;
+            countedRepeat(range.child, min, max, lazy, copies, exits);
+            if (range.max == Unbounded)
+            {
+                RepeatedRange   loop = range;
+                loop.min = 0;
+                repeat(loop, lazy);
+            }
+        }
+        else
+        {
+            for (unsigned long long i = 0; i < range.min; i++)
+                iteration(range.child, copies, exits);
+            if (range.max == Unbounded)
+            {
+                int loop = emit(RegexInst::SPLIT);
+                splits.push_back(loop);
+                iteration(range.child, mark, exits);
+                emit(RegexInst::JMP, loop);
+            }
+            else
+            {
+                for (unsigned long long i = range.min; i < range.max; i++)
+                {
+                    splits.push_back(emit(RegexInst::SPLIT));
+                    iteration(range.child, copies, exits);
+                }
+            }
+        }
+        for (size_t i = 0; i < splits.size(); i++)
+        {
+            RegexInst   &split = prog.insts[splits[i]];
+            split.x = lazy ? prog.insts.size() : splits[i] + 1;
+            split.y = lazy ? splits[i] + 1 : prog.insts.size();
+        }
+        for (size_t i = 0; i < exits.size(); i++)
+            prog.insts[exits[i]].y = prog.insts.size();
+    }
+
+    // one copy of the body, between a MARK and a PROGRESS leaving the
+    // repeat when the body can match empty
+    void    RegexCompiler::iteration(RegexComponentBase const *child, int mark,
+        std::vector<int> &exits)
+    {
+        if (mark >= 0)
+            emit(RegexInst::MARK, mark);
+        compile(child);
+        if (mark >= 0)
+            exits.push_back(emit(RegexInst::PROGRESS, mark));
+    }
+
+    // the body is run while the counter is below max, taking the exit
+    // before or after it once the counter reached min
+    void    RegexCompiler::countedRepeat(RegexComponentBase const *child, int min,
+        int max, bool lazy, int mark, std::vector<int> &exits)
+    {
+        int counter = prog.counters.size();
+
+        prog.counters.push_back(std::make_pair(min, max));
+        emit(RegexInst::REPEAT_START, counter);
+        int loop = emit(RegexInst::REPEAT, counter, 0, lazy);
+        iteration(child, mark, exits);
+        emit(RegexInst::COUNT, counter, loop);
+        prog.insts[loop].y = prog.insts.size();
+    }
+
+    void    RegexCompiler::lookAround(RegexComponentBase const *c, int op)
+    {
+        if (reverse)
+            throw NotReversible();
+        prog.hasLookAround = true;
+        lookArounds.push_back(std::make_pair(c, emit(op, 0,
+            c->component.range->min, c->component.range->max)));
+        lookOrigins.push_back(current);
+    }
+
+    RegexProgram::RegexProgram() : start(0), groups(0), slots(0),
+        hasBackReference(false), hasLookAround(false), hasContextualExits(false),
+        reverse(false), set(false),
+        anyFirst(false),
+        anchoredStart(false), anchoredEnd(false) {}
+
+    const char  *RegexProgram::nextStart(const char *startOfStr, const char *from,
+        const char *end) const
+    {
+        if (from >= end)
+            return NULL;
+        // only the start of the input and of each line can match, the
+        // prefix and the first bytes are checked there
+        if (this->anchoredStart)
+        {
+            for (;;)
+            {
+                if (from != startOfStr && from[-1] != '\n')
+                {
+                    from = static_cast<const char *>(std::memchr(from, '\n', end - from));
+                    if (!from || ++from == end)
+                        return NULL;
+                }
+                if ((this->anyFirst || this->first.has(static_cast<unsigned char>(*from)))
+                    && static_cast<size_t>(end - from) >= this->prefix.size()
+                    && !this->prefix.compare(0, this->prefix.size(), from, this->prefix.size()))
+                    return from;
+                from++;
+                if (from == end)
+                    return NULL;
+            }
+        }
+        if (this->prefix.size() == 1)
+            return static_cast<const char *>(std::memchr(from, this->prefix[0], end - from));
+        if (!this->prefix.empty())
+            return static_cast<const char *>(memmem(from, end - from,
+                this->prefix.data(), this->prefix.size()));
+        if (!this->anyFirst)
+            return this->scanFirst(from, end);
+        return from;
+    }
+
+    bool    RegexProgram::canSkip() const
+    {
+        return !this->prefix.empty() || !this->anyFirst || this->anchoredStart;
+    }
+
+    // A byte c is in the range [lo, lo + width] when (c - lo) mod 256 is
+    // at most width, which compares a whole vector of bytes at once
+    const char  *RegexProgram::scanFirst(const char *from, const char *end) const
+    {
+        size_t  n = this->firstRanges.size();
+
+#if defined(__AVX2__)
+        if (n)
+        {
+            __m256i lo[MaxFirstRanges];
+            __m256i width[MaxFirstRanges];
+            for (size_t i = 0; i < n; i++)
+            {
+                lo[i] = _mm256_set1_epi8(this->firstRanges[i].first);
+                width[i] = _mm256_set1_epi8(this->firstRanges[i].second);
+            }
+            for (; end - from >= 32; from += 32)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(from));
+                __m256i hit = _mm256_setzero_si256();
+                for (size_t i = 0; i < n; i++)
+                {
+                    __m256i x = _mm256_sub_epi8(v, lo[i]);
+                    hit = _mm256_or_si256(hit,
+                        _mm256_cmpeq_epi8(_mm256_min_epu8(x, width[i]), x));
+                }
+                unsigned int mask = _mm256_movemask_epi8(hit);
+                if (mask)
+                    return from + __builtin_ctz(mask);
+            }
+        }
+#endif
+#if defined(__SSE2__)
+        if (n)
+        {
+            __m128i lo[MaxFirstRanges];
+            __m128i width[MaxFirstRanges];
+            for (size_t i = 0; i < n; i++)
+            {
+                lo[i] = _mm_set1_epi8(this->firstRanges[i].first);
+                width[i] = _mm_set1_epi8(this->firstRanges[i].second);
+            }
+            for (; end - from >= 16; from += 16)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(from));
+                __m128i hit = _mm_setzero_si128();
+                for (size_t i = 0; i < n; i++)
+                {
+                    __m128i x = _mm_sub_epi8(v, lo[i]);
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(x, width[i]), x));
+                }
+                unsigned int mask = _mm_movemask_epi8(hit);
+                if (mask)
+                    return from + __builtin_ctz(mask);
+            }
+        }
+#endif
+        (void)n;
+        for (; from < end; from++)
+            if (this->first.has(static_cast<unsigned char>(*from)))
+                return from;
+        return NULL;
+    }
+
+    bool    RegexProgram::mayMatch(const char *startOfStr, const char *endOfStr) const
+    {
+        // the prefix is looked for by nextStart() already
+        if (this->required.empty() || this->required == this->prefix)
+            return true;
+        return memmem(startOfStr, endOfStr - startOfStr,
+            this->required.data(), this->required.size()) != NULL;
+    }
+
+    // the strings are counted by their capacity, their own header aside
+    size_t  RegexProgram::memoryUsage() const
+    {
+        return sizeof(RegexProgram)
+            + this->insts.capacity() * sizeof(RegexInst)
+            + this->classes.capacity() * sizeof(CharClass)
+            + this->counters.capacity() * sizeof(this->counters[0])
+            + this->firstRanges.capacity() * sizeof(this->firstRanges[0])
+            + this->prefix.capacity() + this->required.capacity();
+    }
+
+    RegexProgram   *RegexProgram::compile(RegexComponentBase const *root, size_t groups,
+        bool reverse, std::vector<RegexOrigin> *origins)
+    {
+        RegexProgram    *prog = new RegexProgram();
+
+        prog->reverse = reverse;
+        prog->groups = reverse ? 0 : groups;
+        prog->slots = 2 * prog->groups;
+        try
+        {
+            try
+            {
+                RegexCompiler(*prog, reverse, false, origins).run(root);
+            }
+            catch (ProgramTooLarge const&)
+            {
+                if (reverse)
+                    throw;
+                RegexProgram    *counted = new RegexProgram();
+                counted->groups = prog->groups;
+                counted->slots = prog->slots;
+                delete prog;
+                prog = counted;
+                if (origins)
+                    origins->clear();
+                RegexCompiler(*prog, false, true, origins).run(root);
+            }
+        }
+        catch (ProgramTooLarge const&)
+        {
+            delete prog;
+            return NULL;
+        }
+        catch (NotReversible const&)
+        {
+            delete prog;
+            return NULL;
+        }
+        catch (...)
+        {
+            delete prog;
+            throw;
+        }
+        return prog;
+    }
+
+    RegexProgram   *RegexProgram::combine(std::vector<RegexProgram const *> const& progs,
+        std::vector<int> const& ids)
+    {
+        RegexProgram    *prog = new RegexProgram();
+
+        prog->set = true;
+        try
+        {
+            RegexCompiler(*prog, false).combine(progs, ids);
+        }
+        catch (ProgramTooLarge const&)
+        {
+            delete prog;
+            return NULL;
+        }
+        catch (...)
+        {
+            delete prog;
+            throw;
+        }
+        return prog;
+    }
+
+} // namespace ft
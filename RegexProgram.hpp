@@ -0,0 +1,454 @@
+#pragma once
+
+#include "RegexUtils.hpp"
+#include <vector>
+#include <map>
+#include <string>
+
+namespace ft
+{
+    // One instruction of a RegexProgram
+    // Unless it jumps, an instruction continues at the next one (pc + 1)
+    struct RegexInst
+    {
+        enum
+        {
+            CHAR_CLASS,             // x: index in RegexProgram::classes
+            SPLIT,                  // continue at x, then at y
+            JMP,                    // continue at x
+            SAVE,                   // x: slot receiving the current position
+            START_OF_LINE,
+            END_OF_LINE,
+            WORD_BOUNDARY,
+            NON_WORD_BOUNDARY,
+            BACK_REFERENCE,         // x: group id
+            LOOK_AHEAD,             // x: start of the sub-program
+            NEGATIVE_LOOK_AHEAD,    // x: start of the sub-program
+            LOOK_BEHIND,            // x: start of the sub-program, y..z: widths
+            NEGATIVE_LOOK_BEHIND,   // x: start of the sub-program, y..z: widths
+            MARK,                   // x: slot receiving the position an iteration of a repeat started at
+            PROGRESS,               // x: slot set by MARK, y: exit of the repeat taken when the iteration was empty
+            REPEAT_START,           // x: counter set to 0
+            REPEAT,                 // x: counter, y: loop exit, z: 1 if lazy
+            COUNT,                  // x: counter incremented, y: its REPEAT
+            MATCH,
+        };
+
+        int     op;
+        int     x;
+        int     y;
+        int     z;
+    };
+
+    // Elements of a program: a vector while the program is compiled, or
+    // the bytes of a RegexImage read in place once it is loaded
+    template<class T>
+    class RegexTable
+    {
+        std::vector<T>  owned;
+        T const         *items;
+        size_t          count;
+
+    public:
+        RegexTable() : items(NULL), count(0) {}
+
+        T const&    operator[](size_t i) const { return this->items[i]; }
+        // only while the program is compiled
+        T           &operator[](size_t i) { return this->owned[i]; }
+        size_t      size() const { return this->count; }
+        bool        empty() const { return this->count == 0; }
+        T const     *data() const { return this->items; }
+        // bytes taken from the heap
+        size_t      capacity() const { return this->owned.capacity(); }
+
+        void        push_back(T const& item)
+        {
+            this->owned.push_back(item);
+            this->items = &this->owned[0];
+            this->count = this->owned.size();
+        }
+
+        // the count elements at items are used in place, they must
+        // outlive the table
+        void        map(T const *items, size_t count)
+        {
+            std::vector<T>().swap(this->owned);
+            this->items = items;
+            this->count = count;
+        }
+
+    private:
+        RegexTable(RegexTable const&);
+        RegexTable &operator=(RegexTable const&);
+    };
+
+    // A component of the tree as compiled in a program: its instructions
+    // are [first, end), the ones of its children included. A component is
+    // compiled once per copy of the repeats holding it, the body of a
+    // look-around after the main program
+    struct RegexOrigin
+    {
+        RegexComponentBase const    *component;
+        int                         parent;     // index of the enclosing one, -1 for the root
+        int                         first;
+        int                         end;
+    };
+
+    // What a profiled RegexBacktracker did at each instruction: the times
+    // it ran it, failed on it and went on to pc + 1, to x or to y (a
+    // look-around going to x runs its sub-program). Resumed counts the
+    // alternatives a SPLIT or a REPEAT pushed that were taken after a
+    // failure, they are counted in next, x or y too
+    struct RegexProfile
+    {
+        struct Counts
+        {
+            unsigned long long  runs;
+            unsigned long long  fails;
+            unsigned long long  next;
+            unsigned long long  x;
+            unsigned long long  y;
+            unsigned long long  resumed;
+        };
+
+        std::vector<Counts>     insts;
+        unsigned long long      starts;     // runs of the program at a start position
+    };
+
+    // The component tree lowered to a flat instruction array
+    // Slots [2 * id, 2 * id + 1] hold the bounds of the group id,
+    // the slots after 2 * groups are used by MARK/PROGRESS.
+    // A counted repeat is expanded to copies of its body; when they would
+    // not fit in MaxInstructions, the repeats loop on a single copy with a
+    // counter instead (REPEAT_START, REPEAT, COUNT), only the backtracker
+    // runs such a program
+    struct RegexProgram
+    {
+        static const size_t     MaxInstructions = 1 << 18;
+
+        RegexTable<RegexInst>   insts;
+        RegexTable<CharClass>   classes;
+        int                     start;
+        size_t                  groups;
+        size_t                  slots;
+        bool                    hasBackReference;
+        bool                    hasLookAround;
+        // a greedy repeat is left after an empty iteration of a body whose
+        // empty matches depend on an assertion (\b, ^, $), the DFA does
+        // not know which iterations were empty
+        bool                    hasContextualExits;
+        // min and max iterations of the loop of each counter
+        RegexTable<std::pair<int, int> >    counters;
+        bool                    reverse;
+        bool                    set;        // MATCH x is the id of the pattern, see combine()
+        std::string             prefix;     // literal every match starts with
+        std::string             required;   // longest literal every match contains
+        CharClass               first;      // bytes a match can start with
+        bool                    anyFirst;   // a match may start anywhere
+        // first as ranges [lo, lo + width] when they are few enough to be
+        // tested on a whole SIMD vector
+        static const size_t     MaxFirstRanges = 4;
+        std::vector<std::pair<unsigned char, unsigned char> >  firstRanges;
+        bool                    anchoredStart;  // every match starts at a line start (^)
+        bool                    anchoredEnd;    // every match ends at a line end ($)
+
+        // returns NULL if the program would be larger than MaxInstructions
+        // even with its repeats counted.
+        // A reverse program matches the reversed strings, without captures,
+        // it cannot be built (NULL) with back-references or look-arounds.
+        // origins receives the components in the order they were compiled
+        static RegexProgram     *compile(RegexComponentBase const *root, size_t groups,
+                                    bool reverse = false,
+                                    std::vector<RegexOrigin> *origins = NULL);
+
+        // One program running several ones side by side, the MATCH of
+        // progs[i] gets ids[i] as x. Built for the DFA only: the programs
+        // must be eligible, their captures are not kept apart.
+        // NULL if it would be larger than MaxInstructions
+        static RegexProgram     *combine(std::vector<RegexProgram const *> const& progs,
+                                    std::vector<int> const& ids);
+
+        // first position in [from, end) a match can start at, NULL if none
+        const char              *nextStart(const char *startOfStr, const char *from,
+                                    const char *end) const;
+        // false when nextStart() is always from
+        bool                    canSkip() const;
+        // false when the input lacks the required literal and cannot match
+        bool                    mayMatch(const char *startOfStr, const char *endOfStr) const;
+        // bytes taken from the heap by the program
+        size_t                  memoryUsage() const;
+        // first position in [from, end) holding one of the first bytes,
+        // NULL if none; not to be called when anyFirst
+        const char              *scanFirst(const char *from, const char *end) const;
+
+        private:
+            friend class RegexImage;
+
+            RegexProgram();
+    };
+
+    // Thompson NFA simulation (Pike VM): every thread advances in lock step
+    // so the run time is O(program x input) whatever the pattern is.
+    // Look-arounds are evaluated with an anchored sub-run at the position
+    // they are reached, back-references are not supported.
+    // A thread reaching a pc already reached at the same position is
+    // dropped, unless the pc is in the body of loops whose iteration
+    // started at another position for one thread and not for the other:
+    // the PROGRESS of the loop sends them to different places. The state
+    // of a pc is the number of its enclosing loops, innermost first, whose
+    // iteration started at the current position (an inner iteration starts
+    // after the outer one), each state is visited once
+    class RegexPikeVM
+    {
+        // threads in priority order, seen marks the states already added
+        // for the current position
+        struct ThreadList
+        {
+            std::vector<unsigned int>   seen;
+            unsigned int                generation;
+            std::vector<int>            pcs;
+            std::vector<const char *>   caps;
+            size_t                      size;
+
+            ThreadList(size_t states);
+            bool    visit(int state);
+            void    push(int pc, std::vector<const char *> const& cap);
+            void    clear();
+        };
+
+        struct Job
+        {
+            int             pc;
+            int             slot;       // >= 0 when the job restores a slot
+            const char      *value;
+        };
+
+        RegexProgram const&         prog;
+        const char                  *startOfStr;
+        const char                  *endOfStr;
+        // for each pc, the MARK slots of the loops whose body holds it,
+        // outermost first, and the index of its first state, set
+        // before the thread lists are sized
+        std::vector<std::vector<int> >  loopMarks;
+        std::vector<int>            firstState;
+        ThreadList                  clist;
+        ThreadList                  nlist;
+        std::vector<Job>            jobs;
+        std::vector<const char *>   cap;
+        std::vector<const char *>   seed;
+        // the run of the look-arounds reached by this one and the captures
+        // it starts from, built by the first look-around and kept
+        RegexPikeVM                 *sub;
+        std::vector<const char *>   subSlots;
+
+        RegexPikeVM(RegexPikeVM const&);
+        RegexPikeVM &operator=(RegexPikeVM const&);
+
+        static size_t   states(RegexProgram const&, std::vector<std::vector<int> > &loopMarks,
+                            std::vector<int> &firstState);
+        int     state(int pc, const char *pos) const;
+        void    addThread(ThreadList &, int pc, const char *pos);
+        bool    lookAround(RegexInst const&, const char *pos,
+                    std::vector<const char *> &slots);
+
+    public:
+        RegexPikeVM(RegexProgram const&, const char *startOfStr, const char *endOfStr);
+        ~RegexPikeVM();
+
+        // the thread lists are kept, matching another input does not allocate
+        void    setInput(const char *startOfStr, const char *endOfStr);
+
+        // leftmost-first match of the sub-program at pc, slots holds the
+        // initial captures and receives the ones of the match.
+        // Every start position in [from, stop) is tried unless anchored,
+        // no character at or after stop is consumed
+        bool    run(int pc, const char *from, const char *stop, bool anchored,
+                    bool mustEndAtStop, std::vector<const char *> &slots);
+        bool    search(const char *from, std::vector<const char *> &slots,
+                    bool anchored = false);
+    };
+
+    // Backtracking over the program without recursion: the alternatives
+    // not taken yet and the slot values to restore when backtracking are
+    // kept on a stack on the heap, the input length does not matter to the
+    // C++ stack. Look-arounds are matched with a sub-run and do not leave
+    // alternatives behind them (like the Pike VM).
+    // Without back-references, what follows a SPLIT at a position does
+    // not depend on the captures, a bit per (SPLIT, position) records the
+    // ones already tried: they failed, so each is tried once and the run
+    // time is polynomial. In the body of a loop that can iterate on the
+    // empty string it depends on whether the iteration consumed anything,
+    // the SPLITs reached before it did are not recorded. With counted
+    // loops it depends on the counters, the memo is not used
+    class RegexBacktracker
+    {
+        // a frame restoring the counter c has slot -2 - c and the value in pc
+        struct Frame
+        {
+            int             pc;
+            int             slot;       // >= 0 when the frame restores a slot
+            const char      *pos;       // position to resume at or slot value
+        };
+
+        RegexProgram const&         prog;
+        size_t                      limit;
+        std::vector<Frame>          stack;
+        std::vector<int>            counts;     // iterations of the counted loops
+        const char                  *startOfStr;
+        const char                  *endOfStr;
+        RegexBudget                 *budget;
+        bool                        memoizable;
+        // for each SPLIT, the MARK slots of the loops whose body holds it
+        std::vector<std::vector<int> >  loopMarks;
+        size_t                      memoLimit;
+        bool                        memo;       // the bits are used by this run
+        const char                  *memoBase;  // position of the first bits
+        std::vector<unsigned int>   visited;
+        size_t                      visitedHigh;    // words set since the last clear
+        RegexProfile                *profile;
+        std::vector<int>            pushers;    // pc that pushed each alternative, when profiled
+
+        bool    push(int pc, int slot, const char *pos);
+        bool    visit(int pc, const char *pos, std::vector<const char *> const& slots);
+        void    pushed(int pc);
+        void    went(int from, int to);
+        // the profiled run is a copy of the loop with the counting compiled
+        // in, the other one does not test anything more than before
+        template<bool Profiled>
+        int     run(int pc, const char *pos, const char *stop,
+                    bool mustEndAtStop, std::vector<const char *> &slots);
+        template<bool Profiled>
+        int     lookAround(RegexInst const&, const char *pos,
+                    std::vector<const char *> &slots);
+
+    public:
+        enum
+        {
+            NoMatch,
+            Match,
+            OutOfMemory,    // the stack would use more than the limit
+            Aborted,        // the budget is exhausted
+        };
+
+        static const size_t DefaultLimit = 1 << 25;
+        static const size_t DefaultMemoLimit = 1 << 18;
+
+        RegexBacktracker(RegexProgram const&, size_t limit = DefaultLimit,
+            size_t memoLimit = DefaultMemoLimit);
+
+        // leftmost-first match starting in [from, lastStart] before
+        // endOfStr, slots receives the captures. Each SPLIT and each
+        // backtrack is a step of the budget
+        int     search(const char *startOfStr, const char *endOfStr, const char *from,
+                    const char *lastStart, std::vector<const char *> &slots,
+                    RegexBudget *budget = NULL);
+        void    setLimit(size_t limit);
+        // bytes the memo may use, the searches needing more run without it
+        void    setMemoLimit(size_t limit);
+        // the next searches add what they do to profile, sized to the
+        // program, until it is set back to NULL
+        void    setProfile(RegexProfile *profile);
+    };
+
+    // DFA built lazily from a program without back-references nor
+    // look-arounds: a state is the set of instructions the NFA threads wait
+    // on plus what the previous character was (for ^ and \b), and its
+    // transitions are computed the first time they are taken.
+    // States are cached until they use more than the memory budget, the
+    // cache is then flushed; if it keeps being flushed the search gives up
+    // so the caller can fall back to the NFA
+    class RegexLazyDFA
+    {
+        enum
+        {
+            AfterNewLine = 1,
+            AfterWord = 2,
+            EndOfText = 256,
+        };
+
+        struct State
+        {
+            std::vector<int>    pcs;
+            int                 context;
+            CharClass           matchOn;        // bytes whose transition sees a MATCH
+            bool                matchOnEnd;
+            bool                endComputed;
+            State               *next[256];
+
+            State(std::vector<int> const&, int);
+        };
+
+        typedef std::map<std::vector<int>, State *>  cache_t;
+
+        RegexProgram const&         prog;
+        size_t                      budget;
+        size_t                      used;
+        cache_t                     cache;
+        State                       *start;
+        State                       *idle[4];   // states without threads, by context
+        size_t                      resets;
+        size_t                      scanned;
+        size_t                      scannedAtReset;
+        std::vector<int>            stack;
+        std::vector<int>            key;
+        std::vector<unsigned int>   seen;
+        unsigned int                generation;
+        std::vector<int>            matches;    // MATCH x reached by the last step
+        bool                        mayGiveUp;  // false while a stream is run
+
+        State   *lookup(std::vector<int> const& pcs, int context);
+        State   *step(State *, int c, bool &matched);
+        State   *idleState(const char *p);
+        void    reset();
+
+    public:
+        enum
+        {
+            NoMatch,
+            Match,
+            GaveUp,
+        };
+
+        // Where a stream stands between two chunks: the threads and the
+        // context of the state it reached, which the cache may have
+        // flushed since
+        struct Cursor
+        {
+            std::vector<int>    pcs;
+            int                 context;
+            unsigned long long  offset;     // bytes of the stream read so far
+
+            Cursor();
+        };
+
+        static const size_t DefaultBudget = 1 << 20;
+
+        RegexLazyDFA(RegexProgram const&, size_t budget = DefaultBudget);
+        ~RegexLazyDFA();
+
+        static bool eligible(RegexProgram const*);
+
+        // matches starting in [from, endOfStr), stops at the first position
+        // a match ends at, stored in *matchEnd
+        int     search(const char *startOfStr, const char *from, const char *endOfStr,
+                    const char **matchEnd = NULL);
+        // for a set program: the ids of the patterns matching in the input
+        int     searchSet(const char *startOfStr, const char *endOfStr,
+                    std::vector<int> &ids);
+        // for a reverse program: the leftmost position a match starts at
+        int     searchReverse(const char *startOfStr, const char *endOfStr,
+                    const char **leftmost);
+        // for a stream: runs the next chunk from the cursor, ends receives
+        // the offsets in the stream before which a match ends
+        void    scanStream(Cursor &, const char *from, const char *end,
+                    std::vector<unsigned long long> &ends);
+        // the end of the stream, after its last chunk
+        void    endStream(Cursor &, std::vector<unsigned long long> &ends);
+        void    setBudget(size_t budget);
+
+    private:
+        RegexLazyDFA(RegexLazyDFA const&);
+        RegexLazyDFA &operator=(RegexLazyDFA const&);
+    };
+
+} // namespace ft
@@ -0,0 +1,120 @@
+#include <RegexSet.hpp>
+#include <algorithm>
+
+namespace ft
+{
+    RegexSet::RegexSet() : program(NULL), dfaBudget(DefaultBudget) {}
+
+    // the scratch refer to the program
+    RegexSet::~RegexSet()
+    {
+        this->pool.clear();
+        delete this->program;
+        for (size_t i = 0; i < this->regexes.size(); i++)
+            delete this->regexes[i];
+    }
+
+    size_t  RegexSet::add(std::string const& pattern, unsigned int flags)
+    {
+        this->regexes.push_back(NULL);
+        try
+        {
+            this->regexes.back() = new Regex(pattern, flags);
+        }
+        catch (...)
+        {
+            this->regexes.pop_back();
+            throw;
+        }
+        return this->regexes.size() - 1;
+    }
+
+    // the scratch hold DFAs of the previous program, they are dropped
+    void    RegexSet::compile()
+    {
+        std::vector<RegexProgram const *>   progs;
+        std::vector<int>                    ids;
+
+        delete this->program;
+        this->program = NULL;
+        this->combined.clear();
+        this->others.clear();
+        for (size_t i = 0; i < this->regexes.size(); i++)
+        {
+            if (RegexLazyDFA::eligible(this->regexes[i]->program))
+            {
+                progs.push_back(this->regexes[i]->program);
+                ids.push_back(i);
+                this->combined.push_back(i);
+            }
+            else
+                this->others.push_back(i);
+        }
+        if (!progs.empty())
+            this->program = RegexProgram::combine(progs, ids);
+        // too large to be combined
+        if (!this->program)
+        {
+            this->others.insert(this->others.end(), this->combined.begin(),
+                this->combined.end());
+            std::sort(this->others.begin(), this->others.end());
+            this->combined.clear();
+        }
+        this->pool.clear();
+    }
+
+    size_t  RegexSet::size() const
+    {
+        return this->regexes.size();
+    }
+
+    Regex const&    RegexSet::operator[](size_t id) const
+    {
+        return *this->regexes[id];
+    }
+
+    bool    RegexSet::test(const char *data, size_t len, std::vector<size_t> &ids) const
+    {
+        std::vector<int>    found;
+        int                 res = RegexLazyDFA::NoMatch;
+
+        ids.clear();
+        if (this->program)
+        {
+            Regex::lease_t      lease(this->pool);
+            Regex::scratch_t    &scratch = lease.scratch;
+
+            if (!scratch.dfa)
+                scratch.dfa = new RegexLazyDFA(*this->program, this->dfaBudget);
+            if (scratch.budget != this->dfaBudget)
+                scratch.dfa->setBudget(this->dfaBudget);
+            scratch.budget = this->dfaBudget;
+            res = scratch.dfa->searchSet(data, data + len, found);
+        }
+        if (res == RegexLazyDFA::GaveUp)
+        {
+            for (size_t i = 0; i < this->combined.size(); i++)
+                if (this->regexes[this->combined[i]]->test(data, len))
+                    ids.push_back(this->combined[i]);
+        }
+        else
+            ids.assign(found.begin(), found.end());
+        for (size_t i = 0; i < this->others.size(); i++)
+            if (this->regexes[this->others[i]]->test(data, len))
+                ids.push_back(this->others[i]);
+        if (!this->others.empty())
+            std::sort(ids.begin(), ids.end());
+        return !ids.empty();
+    }
+
+    bool    RegexSet::test(std::string const& str, std::vector<size_t> &ids) const
+    {
+        return this->test(str.data(), str.size(), ids);
+    }
+
+    void    RegexSet::setDFABudget(size_t bytes)
+    {
+        this->dfaBudget = bytes;
+    }
+
+} // namespace ft
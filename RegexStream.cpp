@@ -0,0 +1,59 @@
+#include <RegexStream.hpp>
+#include <stdexcept>
+
+namespace ft
+{
+    RegexStream::RegexStream(Regex const& regex) : regex(regex)
+    {
+        if (!RegexStream::supports(regex))
+            throw std::invalid_argument("RegexStream: the DFA cannot run the regex"
+                " or is disabled");
+    }
+
+    bool    RegexStream::supports(Regex const& regex)
+    {
+        return RegexLazyDFA::eligible(regex.program) && regex.dfaBudget;
+    }
+
+    RegexLazyDFA    &RegexStream::dfa(Regex::lease_t const& lease)
+    {
+        if (!lease.scratch.dfa)
+            throw std::logic_error("RegexStream: the DFA of the regex was disabled");
+        return *lease.scratch.dfa;
+    }
+
+    // a scratch is taken for each chunk, the cursor holds no state of its DFA
+    bool    RegexStream::feed(const char *data, size_t len, std::vector<offset_t> &ends)
+    {
+        Regex::lease_t  lease(this->regex);
+
+        ends.clear();
+        this->dfa(lease).scanStream(this->cursor, data, data + len, ends);
+        return !ends.empty();
+    }
+
+    bool    RegexStream::feed(std::string const& str, std::vector<offset_t> &ends)
+    {
+        return this->feed(str.data(), str.size(), ends);
+    }
+
+    bool    RegexStream::finish(std::vector<offset_t> &ends)
+    {
+        Regex::lease_t  lease(this->regex);
+
+        ends.clear();
+        this->dfa(lease).endStream(this->cursor, ends);
+        return !ends.empty();
+    }
+
+    void    RegexStream::reset()
+    {
+        this->cursor = RegexLazyDFA::Cursor();
+    }
+
+    RegexStream::offset_t   RegexStream::offset() const
+    {
+        return this->cursor.offset;
+    }
+
+} // namespace ft
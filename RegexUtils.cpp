@@ -1,219 +1,289 @@
 #include <RegexUtils.hpp>
+#include <algorithm>
 
 namespace ft
 {
-     Functor::Functor(
-         RegexComponentBase 
-         const*executable,
-         const char* &ptr,
-         unsigned int consumed,
-         MatchInfo* info,
-         Functor *next,
-         const char* prev): executable(executable), ptr(ptr),
-                            consumed(consumed), info(info), next(next), prev(prev) {}
 
-    
+    // Start RegexBudget
+    RegexBudget::RegexBudget(size_t steps, struct timeval const *deadline) :
+        steps(steps), limited(steps != 0), spent(0), timed(deadline != NULL),
+        exhausted(false)
+    {
+        if (deadline)
+            this->deadline = *deadline;
+    }
+
+    bool    RegexBudget::late() const
+    {
+        struct timeval  now;
+
+        gettimeofday(&now, NULL);
+        return now.tv_sec > this->deadline.tv_sec || (now.tv_sec == this->deadline.tv_sec
+            && now.tv_usec >= this->deadline.tv_usec);
+    }
+    // END RegexBudget
 
-    char    invert_case(char c)
+    // Start CharClass
+    CharClass::CharClass()
     {
-        if (c >= 'A' && c <= 'Z')
-            return c + ('a' - 'A');
-        else if (c >= 'a' && c <= 'z')
-            return c - ('a' - 'A');
-        else
-            return c;
+        for (int i = 0; i < 8; i++)
+            this->bits[i] = 0;
     }
 
-    bool    Functor::run()
+    void    CharClass::add(unsigned char c)
     {
-        if (!this->executable)
-            return true;
-        return this->executable->match(this->ptr, this->consumed, this->info, this->next, this->prev);
+        this->bits[c >> 5] |= 1u << (c & 31);
     }
 
-    RegexComponentBase::RegexComponentBase(int type) : type(type)
+    void    CharClass::addRange(unsigned char from, unsigned char to)
     {
-        switch (type)
+        for (int c = from; c <= to; c++)
+            this->add(c);
+    }
+
+    void    CharClass::addClass(CharClass const& other)
+    {
+        for (int i = 0; i < 8; i++)
+            this->bits[i] |= other.bits[i];
+    }
+
+    void    CharClass::invert()
+    {
+        for (int i = 0; i < 8; i++)
+            this->bits[i] = ~this->bits[i];
+    }
+
+    void    CharClass::foldCase()
+    {
+        for (int c = 'A'; c <= 'Z'; c++)
         {
-        case GROUP:
-            this->component.chars = new std::set<char>();
-            break;
-        case INVERSE_GROUP:
-            this->component.chars = new std::set<char>();
-            break;
-        case REPEAT:
-            this->component.range = new RepeatedRange();
-            break;
-        case CONCAT:
-            this->component.children = new std::vector<RegexComponentBase *>();
-            break;
-        case ALTERNATE:
-            this->component.children = new std::vector<RegexComponentBase *>();
-            break;
-        case START_OF_GROUP:
-            this->component.group = new std::pair<const char *, const char *>();
-            break;
-        case END_OF_GROUP:
-            // no need to allocate anything it only needs pointer to groupStart
-            break; 
-        case LOOK_BEHIND:
-            this->component.range = new RepeatedRange();
-            break;
-        case LOOK_AHEAD:
-            this->component.range = new RepeatedRange();
-            break;
-        default:
-            break;
+            if (this->has(c) || this->has(c + ('a' - 'A')))
+            {
+                this->add(c);
+                this->add(c + ('a' - 'A'));
+            }
         }
-    } 
+    }
 
-    RegexComponentBase::~RegexComponentBase()
+    int     CharClass::single() const
     {
-        switch (this->type)
+        int c = -1;
+
+        for (int i = 0; i < 8; i++)
+        {
+            if (!this->bits[i])
+                continue;
+            if (c >= 0 || (this->bits[i] & (this->bits[i] - 1)))
+                return -1;
+            c = i * 32 + __builtin_ctz(this->bits[i]);
+        }
+        return c;
+    }
+
+    static CharClass    makeWordClass()
+    {
+        CharClass   table;
+        table.addRange('a', 'z');
+        table.addRange('A', 'Z');
+        table.addRange('0', '9');
+        table.add('_');
+        return table;
+    }
+
+    static CharClass    makeDigitClass()
+    {
+        CharClass   table;
+        table.addRange('0', '9');
+        return table;
+    }
+
+    static CharClass    makeSpaceClass()
+    {
+        CharClass   table;
+        table.addRange('\t', '\r');
+        table.add(' ');
+        return table;
+    }
+
+    CharClass const&    CharClass::word()
+    {
+        static const CharClass  table = makeWordClass();
+        return table;
+    }
+
+    CharClass const&    CharClass::digit()
+    {
+        static const CharClass  table = makeDigitClass();
+        return table;
+    }
+
+    CharClass const&    CharClass::space()
+    {
+        static const CharClass  table = makeSpaceClass();
+        return table;
+    }
+    // END CharClass
+
+    // Start RegexArena
+    RegexArena::RegexArena() : blocks(NULL), cursor(NULL), limit(NULL), reserved(0) {}
+
+    RegexArena::~RegexArena()
+    {
+        while (this->blocks)
+        {
+            Block   *next = this->blocks->next;
+            ::operator delete(this->blocks);
+            this->blocks = next;
+        }
+    }
+
+    // the blocks double up to MaxBlock, a larger allocation gets a block
+    // of its own; what is left of the current block is lost
+    void    RegexArena::grow(size_t size)
+    {
+        const size_t    header = (sizeof(Block) + Alignment - 1) & ~(Alignment - 1);
+        size_t          bytes = FirstBlock;
+
+        if (this->blocks)
+            bytes = std::min(this->blocks->size * 2, static_cast<size_t>(MaxBlock));
+        if (bytes < header + size)
+            bytes = header + size;
+        Block   *block = static_cast<Block *>(::operator new(bytes));
+        block->next = this->blocks;
+        block->size = bytes;
+        this->blocks = block;
+        this->cursor = reinterpret_cast<char *>(block) + header;
+        this->limit = reinterpret_cast<char *>(block) + bytes;
+        this->reserved += bytes;
+    }
+
+    size_t  RegexArena::size() const
+    {
+        return this->reserved;
+    }
+    // END RegexArena
+
+    // the payload is allocated in the arena with the component
+    RegexComponentBase::RegexComponentBase(int type, RegexArena &arena) : type(type),
+        begin(0), end(0)
+    {
+        switch (type)
         {
         case GROUP:
-            delete this->component.chars;
+            this->component.chars = new (arena.allocate(sizeof(CharClass))) CharClass();
             break;
         case INVERSE_GROUP:
-            delete this->component.chars;
+            this->component.chars = new (arena.allocate(sizeof(CharClass))) CharClass();
             break;
         case REPEAT:
-            delete this->component.range;
+        case LAZY_REPEAT:
+            this->component.range = new (arena.allocate(sizeof(RepeatedRange))) RepeatedRange();
             break;
         case CONCAT:
-            delete this->component.children;
+            this->component.children = new (arena.allocate(sizeof(RegexChildren)))
+                RegexChildren(RegexArena::allocator<RegexComponentBase *>(arena));
             break;
         case ALTERNATE:
-            delete this->component.children;
-            break;
-        case START_OF_GROUP:
-            delete this->component.group;
+            this->component.children = new (arena.allocate(sizeof(RegexChildren)))
+                RegexChildren(RegexArena::allocator<RegexComponentBase *>(arena));
             break;
         case END_OF_GROUP:
-            break;
+            // no need to allocate anything it only needs pointer to groupStart
+            break; 
         case LOOK_BEHIND:
-            delete this->component.range;
+        case NEGATIVE_LOOK_BEHIND:
+            this->component.range = new (arena.allocate(sizeof(RepeatedRange))) RepeatedRange();
             break;
         case LOOK_AHEAD:
-            delete this->component.range;
+        case NEGATIVE_LOOK_AHEAD:
+            this->component.range = new (arena.allocate(sizeof(RepeatedRange))) RepeatedRange();
             break;
         default:
             break;
         }
     }
 
-
     // Start RegexGroup
-    RegexGroup::RegexGroup() : RegexComponentBase(GROUP) {}
+    RegexGroup::RegexGroup(RegexArena &arena) : RegexComponentBase(GROUP, arena) {}
 
-    RegexGroup::RegexGroup(char c) : RegexComponentBase(GROUP)
+    RegexGroup::RegexGroup(RegexArena &arena, char c) : RegexComponentBase(GROUP, arena)
     {
         addChar(c);
     }
 
-    RegexGroup::RegexGroup(char from, char to) : RegexComponentBase(GROUP)
+    RegexGroup::RegexGroup(RegexArena &arena, char from, char to)
+        : RegexComponentBase(GROUP, arena)
     {
         addRangeChar(from, to);
     }
 
-    void    RegexGroup::addChar(char c)
+    RegexGroup::RegexGroup(RegexArena &arena, CharClass const& cls)
+        : RegexComponentBase(GROUP, arena)
     {
-        this->component.chars->insert(c);
+        this->component.chars->addClass(cls);
     }
 
-    void    RegexGroup::addRangeChar(char from, char to)
+    void    RegexGroup::addChar(char c)
     {
-        for (char c = from; c <= to; c++)
-            this->component.chars->insert(c);
+        this->component.chars->add(c);
     }
 
-    bool    RegexGroup::match(const char* &ptr, unsigned long long, MatchInfo *info, Functor*fn, const char*) const
+    void    RegexGroup::addRangeChar(char from, char to)
     {
-        if (ptr != info->endOfStr
-            && (this->component.chars->find(*ptr) 
-                != this->component.chars->end()
-            || (info->flags & RegexComponentBase::iCase
-            && this->component.chars->find(ft::invert_case(*ptr)) 
-                != this->component.chars->end()))
-        )
-        {
-            ptr++;
-            bool    tmp = fn->run();
-            ptr--;
-            return tmp;
-        }
-        return (false);
+        this->component.chars->addRange(from, to);
     }
 
-    
-
     void    RegexGroup::addChild(RegexComponentBase *)
     {
         throw ("RegexGroup::addChild() not implemented");
     }
 
-    RegexGroup::~RegexGroup() {}
-
     // END RegexGroup
 
     // Start RegexInverseGroup
-    RegexInverseGroup::RegexInverseGroup() : RegexComponentBase(GROUP) {}
+    RegexInverseGroup::RegexInverseGroup(RegexArena &arena)
+        : RegexComponentBase(INVERSE_GROUP, arena) {}
 
-    RegexInverseGroup::RegexInverseGroup(char c) : RegexComponentBase(GROUP)
+    RegexInverseGroup::RegexInverseGroup(RegexArena &arena, char c)
+        : RegexComponentBase(INVERSE_GROUP, arena)
     {
         addChar(c);
     }
 
-    RegexInverseGroup::RegexInverseGroup(char from, char to) 
-        : RegexComponentBase(GROUP)
+    RegexInverseGroup::RegexInverseGroup(RegexArena &arena, char from, char to) 
+        : RegexComponentBase(INVERSE_GROUP, arena)
     {
         addRangeChar(from, to);
     }
 
-    void    RegexInverseGroup::addChar(char c)
+    RegexInverseGroup::RegexInverseGroup(RegexArena &arena, CharClass const& cls)
+        : RegexComponentBase(INVERSE_GROUP, arena)
     {
-        this->component.chars->insert(c);
+        this->component.chars->addClass(cls);
     }
 
-    void    RegexInverseGroup::addRangeChar(char from, char to)
+    void    RegexInverseGroup::addChar(char c)
     {
-        for (char c = from; c <= to; c++)
-            this->component.chars->insert(c);
+        this->component.chars->add(c);
     }
 
-    bool    RegexInverseGroup::match(const char* &ptr, unsigned long long, MatchInfo *info, Functor*fn, const char*) const
+    void    RegexInverseGroup::addRangeChar(char from, char to)
     {
-       if (ptr != info->endOfStr
-            && (this->component.chars->find(*ptr) 
-                == this->component.chars->end()
-            || (info->flags & RegexComponentBase::iCase
-            && this->component.chars->find(ft::invert_case(*ptr)) 
-                == this->component.chars->end()))
-        )
-        {
-            ptr++;
-            bool    tmp = fn->run();
-            ptr--;
-            return tmp;
-        }
-        return (false);
+        this->component.chars->addRange(from, to);
     }
 
-   
-
     void    RegexInverseGroup::addChild(RegexComponentBase *)
     {
         throw ("RegexInverseGroup::addChild() not implemented");
     }
 
-    RegexInverseGroup::~RegexInverseGroup() {}
     // END RegexInverseGroup
 
     // Start RegexConcat
-    RegexConcat::RegexConcat() : RegexComponentBase(CONCAT) {}
+    RegexConcat::RegexConcat(RegexArena &arena) : RegexComponentBase(CONCAT, arena) {}
 
-    RegexConcat::RegexConcat(
-        RegexComponentBase *child1) : RegexComponentBase(CONCAT)
+    RegexConcat::RegexConcat(RegexArena &arena, RegexComponentBase *child1)
+        : RegexComponentBase(CONCAT, arena)
     {
         addChild(child1);
     }
@@ -223,14 +293,6 @@ namespace ft
         this->component.children->push_back(child);
     }
 
-    bool    RegexConcat::match(const char* &ptr, unsigned long long ctx, MatchInfo *info, Functor*fn, const char*) const
-    {
-        if (ctx == this->component.children->size())
-            return fn->run();
-        Functor newFn(this, ptr, ctx + 1, info, fn);
-        return this->component.children->at(ctx)->match(ptr, 0, info, &newFn);
-    }
-
     void    RegexConcat::addChar(char)
     {
         throw ("RegexConcat::addChar() not implemented");
@@ -241,18 +303,14 @@ namespace ft
         throw ("RegexConcat::addRangeChar() not implemented");
     }
 
-    RegexConcat::~RegexConcat() 
-    {
-        for (size_t i = 0; i < this->component.children->size(); i++)
-            delete this->component.children->at(i);
-    }
     // END RegexConcat
 
     // Start RegexAlternate
-    RegexAlternate::RegexAlternate() : RegexComponentBase(ALTERNATE) {}
+    RegexAlternate::RegexAlternate(RegexArena &arena)
+        : RegexComponentBase(ALTERNATE, arena) {}
 
-    RegexAlternate::RegexAlternate(
-        RegexComponentBase *child1) : RegexComponentBase(ALTERNATE)
+    RegexAlternate::RegexAlternate(RegexArena &arena, RegexComponentBase *child1)
+        : RegexComponentBase(ALTERNATE, arena)
     {
         addChild(child1);
     }
@@ -262,16 +320,6 @@ namespace ft
         this->component.children->push_back(child);
     }
 
-    bool   RegexAlternate::match(const char* &ptr, unsigned long long ctx, MatchInfo *info, Functor*fn, const char*) const
-    {
-        if (ctx == this->component.children->size())
-            return false;
-        bool    res = this->component.children->at(ctx)->match(ptr, 0, info, fn);
-        if (res)
-            return res;
-        return this->match(ptr, ctx + 1, info, fn);
-    }
-
     void    RegexAlternate::addChar(char)
     {
         throw ("RegexAlternate::addChar() not implemented");
@@ -282,31 +330,21 @@ namespace ft
         throw ("RegexAlternate::addRangeChar() not implemented");
     }
 
-    RegexAlternate::~RegexAlternate()
-    {
-        for (size_t i = 0; i < this->component.children->size(); i++)
-            delete this->component.children->at(i);
-    }
-
     // END RegexAlternate
 
     // Start RegexRepeat
 
-    RegexRepeat::RegexRepeat() : RegexComponentBase(REPEAT) {
-        throw ("RegexRepeat::RegexRepeat() not implemented");
-    }
-
-    RegexRepeat::RegexRepeat(
-        RegexComponentBase *child1,
+    RegexRepeat::RegexRepeat(RegexArena &arena, RegexComponentBase *child1,
         unsigned long long min,
-        unsigned long long max) : RegexComponentBase(REPEAT)
+        unsigned long long max) : RegexComponentBase(REPEAT, arena)
     {
         this->component.range->child = child1;
         this->component.range->min = min;
         this->component.range->max = max;
     }
 
-    RegexRepeat::RegexRepeat(RepeatedRange r) : RegexComponentBase(REPEAT)
+    RegexRepeat::RegexRepeat(RegexArena &arena, RepeatedRange r)
+        : RegexComponentBase(REPEAT, arena)
     {
 
         this->component.range->child = r.child;
@@ -314,24 +352,6 @@ namespace ft
         this->component.range->max = r.max;
     }
 
-    bool    RegexRepeat::match(const char* &ptr, unsigned long long ctx, MatchInfo *info, Functor*fn, const char* prev) const
-    {
-        if (ctx > this->component.range->max)
-            return false;
-
-        if (prev == ptr)
-            return fn->run();
-        
-        Functor newFn(this, ptr, ctx + 1, info, fn, ptr);
-        bool    res = this->component.range->child->match(ptr, 0, info, &newFn);
-
-        if (res)
-            return res;
-        if (ctx >= this->component.range->min)
-            return fn->run();
-        return false;
-    }
-
     void    RegexRepeat::addChild(RegexComponentBase *child)
     {
         this->component.children->push_back(child);
@@ -347,30 +367,21 @@ namespace ft
         throw ("RegexRepeat::addRangeChar() not implemented");
     }
 
-    RegexRepeat::~RegexRepeat()
-    {
-        delete this->component.range->child;
-    }
-
     // END RegexRepeat
 
     // Start RegexRepeatLazy
 
-    RegexRepeatLazy::RegexRepeatLazy() : RegexComponentBase(REPEAT) {
-        throw ("RegexRepeatLazy::RegexRepeatLazy() not implemented");
-    }
-
-    RegexRepeatLazy::RegexRepeatLazy(
-        RegexComponentBase *child1,
+    RegexRepeatLazy::RegexRepeatLazy(RegexArena &arena, RegexComponentBase *child1,
         unsigned long long min,
-        unsigned long long max) : RegexComponentBase(REPEAT)
+        unsigned long long max) : RegexComponentBase(LAZY_REPEAT, arena)
     {
         this->component.range->child = child1;
         this->component.range->min = min;
         this->component.range->max = max;
     }
 
-    RegexRepeatLazy::RegexRepeatLazy(RepeatedRange r) : RegexComponentBase(REPEAT)
+    RegexRepeatLazy::RegexRepeatLazy(RegexArena &arena, RepeatedRange r)
+        : RegexComponentBase(LAZY_REPEAT, arena)
     {
 
         this->component.range->child = r.child;
@@ -378,22 +389,6 @@ namespace ft
         this->component.range->max = r.max;
     }
 
-    bool    RegexRepeatLazy::match(const char* &ptr, unsigned long long ctx, MatchInfo *info, Functor*fn, const char*) const
-    {
-        if (ctx > this->component.range->max)
-            return false;
-
-        bool matched = false;
-        if (ctx >= this->component.range->min)
-            matched = fn->run();
-        if (!matched && ctx < this->component.range->max)
-        {
-            Functor newFn(this, ptr, ctx + 1, info, fn, ptr);
-            return this->component.range->child->match(ptr, 0, info, &newFn);
-        }
-        return matched;
-    }
-
     void    RegexRepeatLazy::addChild(RegexComponentBase *child)
     {
         this->component.children->push_back(child);
@@ -409,46 +404,12 @@ namespace ft
         throw ("RegexRepeatLazy::addRangeChar() not implemented");
     }
 
-    RegexRepeatLazy::~RegexRepeatLazy()
-    {
-        delete this->component.range->child;
-    }
-
     // END RegexRepeatLazy
 
     // Start RegexStartOfGroup
 
-    RegexStartOfGroup::RegexStartOfGroup() : 
-        RegexComponentBase(START_OF_GROUP)
-    {
-        this->component.group->first = NULL;
-        this->component.group->second = NULL;
-    }
-    
-    bool    RegexStartOfGroup::match(const char* &ptr, unsigned long long, MatchInfo *, Functor*fn, const char*) const
-    {
-        std::pair<const char *, const char *> tmp = getCapturedGroup();
-        this->component.group->first = ptr;
-        bool matched = fn->run();
-        if (!matched || !this->component.group->second)
-        {
-            this->component.group->first = tmp.first;
-            this->component.group->second = tmp.second;
-        }
-        return matched;
-    }
-
-    void    RegexStartOfGroup::capture(const char *end)
-    {
-        if (end != this->component.group->first)
-            this->component.group->second = end;
-    }
-
-    std::pair<const char *, const char *>
-    RegexStartOfGroup::getCapturedGroup() const
-    {
-        return *this->component.group;
-    }
+    RegexStartOfGroup::RegexStartOfGroup(RegexArena &arena, size_t id) : 
+        RegexComponentBase(START_OF_GROUP, arena), id(id) {}
 
     void    RegexStartOfGroup::addChild(RegexComponentBase *)
     {
@@ -465,39 +426,15 @@ namespace ft
         throw ("RegexStartOfGroup::addRangeChar() not implemented");
     }
 
-    RegexStartOfGroup::~RegexStartOfGroup() {}
-
     // END RegexStartOfGroup
 
     // Start RegexEndOfGroup
     
-    RegexEndOfGroup::RegexEndOfGroup() : RegexComponentBase(END_OF_GROUP) {}
-
-    RegexEndOfGroup::RegexEndOfGroup(RegexStartOfGroup *group) : 
-        RegexComponentBase(END_OF_GROUP)
+    RegexEndOfGroup::RegexEndOfGroup(RegexArena &arena, RegexStartOfGroup *group) : 
+        RegexComponentBase(END_OF_GROUP, arena)
     {
         this->component.groupStart = group;
     }
-    bool    RegexEndOfGroup::match(const char* &ptr, unsigned long long, MatchInfo *, Functor*fn, const char*) const
-    {
-        std::pair<const char *, const char *> tmp = this->component.groupStart->getCapturedGroup();
-        this->component.groupStart->capture(ptr);
-        bool matched = fn->run();
-        /*
-        ^<([a-z]+)([^<]*)(?:>(.*)<\/\1>|\s+\/>)$
-        <head><meta charset="UTF-8">
-        <meta http-equiv="X-UA-Compatible"
-        content="IE=edge"><meta name="viewport"
-        content="width=device-width, initial-scale=1.0">
-        <title>Document</title></head>
-        */
-        if (!matched)
-        {
-            this->component.groupStart->component.group->first = tmp.first;
-            this->component.groupStart->component.group->second = tmp.second;
-        }
-        return matched;
-    }
 
     void    RegexEndOfGroup::addChild(RegexComponentBase *)
     {
@@ -514,65 +451,16 @@ namespace ft
         throw ("RegexEndOfGroup::addRangeChar() not implemented");
     }
 
-    RegexEndOfGroup::~RegexEndOfGroup() {}
-
     // END RegexEndOfGroup
 
-
-    // Start RegexEnd
-    RegexEnd::RegexEnd() : RegexComponentBase(END) {}
-
-    bool    RegexEnd::match(const char* &, unsigned long long, MatchInfo *, Functor*, const char*) const
-    {
-        return true;
-    }
-
-    void    RegexEnd::addChild(RegexComponentBase *)
-    {
-        throw ("RegexEnd::addChild() not implemented");
-    }
-
-    void    RegexEnd::addChar(char)
-    {
-        throw ("RegexEnd::addChar() not implemented");
-    }
-
-    void    RegexEnd::addRangeChar(char , char )
-    {
-        throw ("RegexEnd::addRangeChar() not implemented");
-    }
-
-    RegexEnd::~RegexEnd() {}
-
-    // END RegexEnd
-
     // Start RegexBackReference
 
-    RegexBackReference::RegexBackReference() : RegexComponentBase(BACK_REFERENCE) {}
-
-    RegexBackReference::RegexBackReference(RegexStartOfGroup *group) : 
-        RegexComponentBase(BACK_REFERENCE)
+    RegexBackReference::RegexBackReference(RegexArena &arena, RegexStartOfGroup *group) : 
+        RegexComponentBase(BACK_REFERENCE, arena)
     {
         this->component.groupStart = group;
     }
 
-    bool    RegexBackReference::match(const char* &ptr, unsigned long long , MatchInfo *, Functor*fn, const char*) const
-    {
-        std::pair<const char *, const char *> const& group = this->component.groupStart->getCapturedGroup();
-        if (group.first == NULL || group.first == group.second)
-            return fn->run();
-        const char *start = group.first;
-        const char *end = group.second;
-        const char *p = ptr;
-        while (start != end && *ptr && *start == *ptr)
-            ++start, ++ptr;
-        bool res = false;
-        if (start == end)
-            return fn->run();
-        ptr = p;
-        return res;
-    }
-
     void    RegexBackReference::addChild(RegexComponentBase *)
     {
         throw ("RegexBackReference::addChild() not implemented");
@@ -588,25 +476,12 @@ namespace ft
         throw ("RegexBackReference::addRangeChar() not implemented");
     }
 
-    RegexBackReference::~RegexBackReference() {}
-
     // END RegexBackReference
 
     // Start RegexStartOfLine
 
-    RegexStartOfLine::RegexStartOfLine() : RegexComponentBase(START_OF_LINE) {}
-
-    void    RegexStartOfLine::setStart(const char *start)
-    {
-        this->component.startOfString = start;
-    }
-
-    bool    RegexStartOfLine::match(const char* &ptr, unsigned long long, MatchInfo *info, Functor*fn, const char*) const
-    {
-        if (ptr == info->startOfStr || *(ptr - 1) == '\n')
-            return fn->run();
-        return false;
-    }
+    RegexStartOfLine::RegexStartOfLine(RegexArena &arena)
+        : RegexComponentBase(START_OF_LINE, arena) {}
 
     void    RegexStartOfLine::addChild(RegexComponentBase *)
     {
@@ -623,20 +498,12 @@ namespace ft
         throw ("RegexStartOfLine::addRangeChar() not implemented");
     }
 
-    RegexStartOfLine::~RegexStartOfLine() {}
-
     // END RegexStartOfLine
 
     // Start RegexEndOfLine
 
-    RegexEndOfLine::RegexEndOfLine() : RegexComponentBase(END_OF_LINE) {}
-
-    bool    RegexEndOfLine::match(const char* &ptr, unsigned long long, MatchInfo *info, Functor*fn, const char*) const
-    {
-        if (ptr == info->endOfStr || *ptr == '\n')
-            return fn->run();
-        return false;
-    }
+    RegexEndOfLine::RegexEndOfLine(RegexArena &arena)
+        : RegexComponentBase(END_OF_LINE, arena) {}
 
     void    RegexEndOfLine::addChild(RegexComponentBase *)
     {
@@ -653,25 +520,12 @@ namespace ft
         throw ("RegexEndOfLine::addRangeChar() not implemented");
     }
 
-    RegexEndOfLine::~RegexEndOfLine() {}
-
     // END RegexEndOfLine
 
     // Start RegexWordBoundary
 
-    RegexWordBoundary::RegexWordBoundary() : RegexComponentBase(WORD_BOUNDARY) {}
-
-    bool    RegexWordBoundary::match(const char* &ptr, unsigned long long, MatchInfo *info, Functor*fn, const char*) const
-    {
-        if ((ptr == info->startOfStr &&  (isalnum(*ptr) || *ptr == '_'))
-            || (ptr == info->endOfStr 
-                &&  (isalnum(*(ptr - 1)) || *(ptr - 1) == '_'))
-            || (ptr != info->startOfStr && ptr != info->endOfStr 
-                && (isalnum(*(ptr - 1)) || *(ptr - 1) == '_') 
-                    ^ (isalnum(*ptr) || *ptr == '_')))
-            return fn->run();
-        return false;
-    }
+    RegexWordBoundary::RegexWordBoundary(RegexArena &arena)
+        : RegexComponentBase(WORD_BOUNDARY, arena) {}
 
     void    RegexWordBoundary::addChild(RegexComponentBase *)
     {
@@ -688,25 +542,12 @@ namespace ft
         throw ("RegexWordBoundary::addRangeChar() not implemented");
     }
 
-    RegexWordBoundary::~RegexWordBoundary() {}
-
     // END RegexWordBoundary
 
     // Start RegexNonWordBoundary
 
-    RegexNonWordBoundary::RegexNonWordBoundary() : RegexComponentBase(WORD_BOUNDARY) {}
-
-    bool    RegexNonWordBoundary::match(const char* &ptr, unsigned long long, MatchInfo *info, Functor*fn, const char*) const
-    {
-        if (!((ptr == info->startOfStr &&  (isalnum(*ptr) || *ptr == '_'))
-            || (ptr == info->endOfStr 
-                &&  (isalnum(*(ptr - 1)) || *(ptr - 1) == '_'))
-            || (ptr != info->startOfStr && ptr != info->endOfStr 
-                && (isalnum(*(ptr - 1)) || *(ptr - 1) == '_') 
-                    ^ (isalnum(*ptr) || *ptr == '_'))))
-            return fn->run();
-        return false;
-    }
+    RegexNonWordBoundary::RegexNonWordBoundary(RegexArena &arena)
+        : RegexComponentBase(NON_WORD_BOUNDARY, arena) {}
 
     void    RegexNonWordBoundary::addChild(RegexComponentBase *)
     {
@@ -723,36 +564,12 @@ namespace ft
         throw ("RegexNonWordBoundary::addRangeChar() not implemented");
     }
 
-    RegexNonWordBoundary::~RegexNonWordBoundary() {}
-
     // END RegexNonWordBoundary
 
     // Start RegexPositiveLookBehind
 
-    RegexPositiveLookBehind::RegexPositiveLookBehind() : 
-        RegexComponentBase(LOOK_BEHIND) {}
-
-    bool    RegexPositiveLookBehind::match(const char* &ptr, unsigned long long ctx, MatchInfo *info, Functor*fn, const char*prev) const
-    {
-        if (this->component.range->min + ctx > this->component.range->max)
-            return false;
-        
-        if (prev != NULL && prev != ptr)
-            return false;
-        if (prev == ptr)
-            return fn->run();
-        
-        if (info->startOfStr + ctx + this->component.range->min > ptr)
-            return false;
-
-        Functor newFn(this, ptr, ctx, info, fn, ptr);
-        ptr -= this->component.range->min + ctx;
-        if (this->component.range->child->match(ptr, ctx, info, &newFn))
-            return true;
-        ptr += this->component.range->min + ctx;
-        
-        return this->match(ptr, ctx + 1, info, fn);
-    }
+    RegexPositiveLookBehind::RegexPositiveLookBehind(RegexArena &arena) : 
+        RegexComponentBase(LOOK_BEHIND, arena) {}
 
     void    RegexPositiveLookBehind::addChild(RegexComponentBase *)
     {
@@ -769,42 +586,12 @@ namespace ft
         throw ("RegexPositiveLookBehind::addRangeChar() not implemented");
     }
 
-    RegexPositiveLookBehind::~RegexPositiveLookBehind() 
-    {
-        delete this->component.range->child;
-    }
-
     // END RegexPositiveLookBehind
 
     // Start RegexNegativeLookBehind
 
-    RegexNegativeLookBehind::RegexNegativeLookBehind() : 
-        RegexComponentBase(LOOK_BEHIND) {}
-
-    bool    RegexNegativeLookBehind::match(const char* &ptr, unsigned long long ctx, MatchInfo *info, Functor*fn, const char*prev) const
-    {
-        if (prev == ptr)
-            return true;
-        else if (prev != NULL && prev != ptr)
-            return false;
-
-        while (1)
-        {
-            if (info->startOfStr + ctx + this->component.range->min > ptr)
-                return fn->run();
-            if (this->component.range->min + ctx > this->component.range->max)
-                return fn->run();
-            Functor newFn(this, ptr, ctx, info, fn, ptr);
-            ptr -= this->component.range->min + ctx;
-            if (this->component.range->child->match(ptr, ctx, info, &newFn))
-            {
-                ptr += this->component.range->min + ctx;
-                return false;
-            }
-            ptr += this->component.range->min + ctx;
-            ++ctx;
-        }
-    }
+    RegexNegativeLookBehind::RegexNegativeLookBehind(RegexArena &arena) : 
+        RegexComponentBase(NEGATIVE_LOOK_BEHIND, arena) {}
 
     void    RegexNegativeLookBehind::addChild(RegexComponentBase *)
     {
@@ -821,31 +608,12 @@ namespace ft
         throw ("RegexNegativeLookBehind::addRangeChar() not implemented");
     }
 
-    RegexNegativeLookBehind::~RegexNegativeLookBehind() 
-    {
-        delete this->component.range->child;
-    }
-
     // END RegexNegativeLookBehind
 
     // Start RegexPositiveLookAhead
 
-    RegexPositiveLookAhead::RegexPositiveLookAhead() : 
-        RegexComponentBase(LOOK_AHEAD) {}
-
-    bool    RegexPositiveLookAhead::match(const char* &ptr, unsigned long long ctx, MatchInfo *info, Functor*fn, const char* prev) const
-    {
-        if (prev != NULL)
-        {
-            ptr = prev;
-            return fn->run();
-        }
-  
-
-        Functor newFn(this, ptr, ctx, info, fn, ptr);
-        return  (this->component.range->child->match(ptr, ctx, info, &newFn));
-         
-    }
+    RegexPositiveLookAhead::RegexPositiveLookAhead(RegexArena &arena) : 
+        RegexComponentBase(LOOK_AHEAD, arena) {}
 
     void    RegexPositiveLookAhead::addChild(RegexComponentBase *)
     {
@@ -862,31 +630,12 @@ namespace ft
         throw ("RegexPositiveLookAhead::addRangeChar() not implemented");
     }
 
-    RegexPositiveLookAhead::~RegexPositiveLookAhead() 
-    {
-        delete this->component.range->child;
-    }
-
     // END RegexPositiveLookAhead
 
     // Start RegexNegativeLookAhead
 
-    RegexNegativeLookAhead::RegexNegativeLookAhead() : 
-        RegexComponentBase(LOOK_AHEAD) {}
-
-    bool    RegexNegativeLookAhead::match(const char* &ptr, unsigned long long ctx, MatchInfo *info, Functor*fn, const char* prev) const
-    {
-        if (prev != NULL)
-        {
-            return true;
-        }
-        prev = ptr;
-        Functor newFn(this, ptr, ctx, info, fn, ptr);
-        if (!(this->component.range->child->match(ptr, ctx, info, &newFn)))
-            return fn->run();
-        ptr = prev;
-        return false;
-    }
+    RegexNegativeLookAhead::RegexNegativeLookAhead(RegexArena &arena) : 
+        RegexComponentBase(NEGATIVE_LOOK_AHEAD, arena) {}
 
     void    RegexNegativeLookAhead::addChild(RegexComponentBase *)
     {
@@ -903,14 +652,8 @@ namespace ft
         throw ("RegexNegativeLookAhead::addRangeChar() not implemented");
     }
 
-    RegexNegativeLookAhead::~RegexNegativeLookAhead() 
-    {
-        delete this->component.range->child;
-    }
-
     // END RegexNegativeLookAhead
 
 }// namespace ft
 
-
 // a?abc(p*|ft)+0+ abcftpppppp0
\ No newline at end of file
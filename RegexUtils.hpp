@@ -3,8 +3,10 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <set>
 #include <exception>
+#include <new>
+#include <cstddef>
+#include <sys/time.h>
 namespace ft
 {
     class Regex;
@@ -13,13 +15,159 @@ namespace ft
     struct RegexStartOfGroup;
     struct RegexEndOfGroup;
 
-    // types of regexComponents
-   struct MatchInfo
-   {
-        const char          *startOfStr;
-        const char          *endOfStr;
-        unsigned long long  flags;
-   };
+    // Work a match may do: a number of steps and a deadline, checked
+    // once every CheckEvery steps so the clock is rarely read
+    struct RegexBudget
+    {
+        static const size_t CheckEvery = 1024;
+
+        size_t          steps;      // left, when limited
+        bool            limited;
+        size_t          spent;
+        bool            timed;
+        struct timeval  deadline;
+        bool            exhausted;
+
+        // steps 0 and deadline NULL do not limit anything
+        RegexBudget(size_t steps = 0, struct timeval const *deadline = NULL);
+
+        // false once the budget is exhausted
+        bool    spend()
+        {
+            if (this->exhausted)
+                return false;
+            if (this->limited && this->steps == 0)
+                this->exhausted = true;
+            else if (this->timed && ++this->spent % CheckEvery == 0 && this->late())
+                this->exhausted = true;
+            else if (this->limited)
+                --this->steps;
+            return !this->exhausted;
+        }
+
+        private:
+            bool    late() const;
+    };
+
+    // 256-bit membership table indexed by the byte value
+    // Case folding is applied once when the table is built (see foldCase)
+    // so matching a character is a single bit test
+    struct CharClass
+    {
+        unsigned int    bits[8];
+
+        CharClass();
+
+        void    add(unsigned char c);
+        void    addRange(unsigned char from, unsigned char to);
+        void    addClass(CharClass const&);
+        void    invert();
+        void    foldCase();
+        int     single() const;     // the only byte of the class or -1
+        bool    has(unsigned char c) const
+        {
+            return (this->bits[c >> 5] >> (c & 31)) & 1;
+        }
+
+        static CharClass const& word();
+        static CharClass const& digit();
+        static CharClass const& space();
+    };
+
+    // Memory of one component tree: the nodes and their payloads are
+    // carved from a few blocks that are only freed together, when the
+    // arena is destroyed. Nothing allocated in it is ever destroyed
+    class RegexArena
+    {
+        struct Block
+        {
+            Block   *next;
+            size_t  size;       // header included
+        };
+
+        Block   *blocks;        // the current one first
+        char    *cursor;
+        char    *limit;
+        size_t  reserved;
+
+        void    grow(size_t);
+        RegexArena(RegexArena const&);
+        RegexArena &operator=(RegexArena const&);
+
+    public:
+        static const size_t FirstBlock = 1 << 10;
+        static const size_t MaxBlock = 1 << 16;
+        static const size_t Alignment = 2 * sizeof(void *);
+
+        RegexArena();
+        ~RegexArena();
+
+        void    *allocate(size_t size)
+        {
+            size = (size + Alignment - 1) & ~(Alignment - 1);
+            if (static_cast<size_t>(this->limit - this->cursor) < size)
+                this->grow(size);
+            void    *p = this->cursor;
+            this->cursor += size;
+            return p;
+        }
+        // bytes the arena took from the heap
+        size_t  size() const;
+
+        // lets a container of the tree take its memory from the arena,
+        // what it frees is only reclaimed with the arena
+        template <class T>
+        class allocator
+        {
+        public:
+            typedef T           value_type;
+            typedef T           *pointer;
+            typedef T const     *const_pointer;
+            typedef T           &reference;
+            typedef T const     &const_reference;
+            typedef size_t      size_type;
+            typedef ptrdiff_t   difference_type;
+            template <class U>
+            struct rebind
+            {
+                typedef allocator<U>    other;
+            };
+
+            RegexArena  *arena;
+
+            allocator(RegexArena &arena) : arena(&arena) {}
+            template <class U>
+            allocator(allocator<U> const& other) : arena(other.arena) {}
+
+            pointer         allocate(size_type n, void const * = 0)
+            {
+                return static_cast<pointer>(this->arena->allocate(n * sizeof(T)));
+            }
+            void            deallocate(pointer, size_type) {}
+            void            construct(pointer p, T const& value)
+            {
+                new (static_cast<void *>(p)) T(value);
+            }
+            void            destroy(pointer p)
+            {
+                p->~T();
+            }
+            pointer         address(reference r) const { return &r; }
+            const_pointer   address(const_reference r) const { return &r; }
+            size_type       max_size() const { return static_cast<size_t>(-1) / sizeof(T); }
+            bool            operator==(allocator const& other) const
+            {
+                return this->arena == other.arena;
+            }
+            bool            operator!=(allocator const& other) const
+            {
+                return this->arena != other.arena;
+            }
+        };
+    };
+
+    typedef std::vector<RegexComponentBase *,
+        RegexArena::allocator<RegexComponentBase *> >   RegexChildren;
 
     struct RepeatedRange
     {
@@ -36,30 +184,31 @@ namespace ft
     // each once of the uses one  of its members
     union RegexComponentType
     {
-        std::set<char>                          *chars;
-        std::vector<RegexComponentBase *>       *children;
+        CharClass                               *chars;
+        RegexChildren                           *children;
         RepeatedRange                           *range;
-        std::pair<const char *, const char *>   *group;
         RegexStartOfGroup                       *groupStart;
-        const char *                            startOfString;
     };
 
     
-    class Functor;
     
     // This is the base class for all regex components
+    // The components are allocated in the arena of their Regex and freed
+    // with it, they are never deleted one by one
     class RegexComponentBase
     {
     public: // TODO: make them protected if possible
         const static unsigned int   Infinity = ~0;
         int                         type;
         RegexComponentType          component;
+        // the bytes of the pattern it was parsed from, [begin, end)
+        size_t                      begin;
+        size_t                      end;
         
 
         virtual void    addChar(char) = 0;
         virtual void    addRangeChar(char, char) = 0;
         virtual void    addChild(RegexComponentBase *) = 0;
-        virtual bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const = 0;
         enum
         {
             GROUP,
@@ -71,39 +220,32 @@ namespace ft
             END_OF_LINE,
             START_OF_GROUP,
             END_OF_GROUP,
-            END,
             BACK_REFERENCE,
             WORD_BOUNDARY,
             LOOK_BEHIND,
             LOOK_AHEAD,
+            LAZY_REPEAT,
+            NON_WORD_BOUNDARY,
+            NEGATIVE_LOOK_BEHIND,
+            NEGATIVE_LOOK_AHEAD,
         };
 
         enum 
         {
             iCase = 4,
         };
-        virtual ~RegexComponentBase();
+
+        static void     *operator new(size_t size, RegexArena &arena)
+        {
+            return arena.allocate(size);
+        }
+        static void     operator delete(void *, RegexArena &) {}
     protected:
-        RegexComponentBase(int type);
+        RegexComponentBase(int type, RegexArena &);
     };
 
     
 
-    class Functor
-    {
-        private:
-            const RegexComponentBase    *executable;
-            const char*                 &ptr;
-            unsigned int                consumed;
-            MatchInfo                   *info; 
-            Functor                     *next;
-            const char*                 prev;
-
-        public:
-            Functor(RegexComponentBase const *executable, const char* &ptr, unsigned int consumed, MatchInfo* info, Functor *next, const char *prev = NULL);
-            bool    run();
-    };
-
    
 
 
@@ -112,14 +254,13 @@ namespace ft
 
     struct RegexGroup : public RegexComponentBase
     {
-        RegexGroup();
-        RegexGroup(char c);
-        RegexGroup(char from, char to);
+        RegexGroup(RegexArena &);
+        RegexGroup(RegexArena &, char c);
+        RegexGroup(RegexArena &, char from, char to);
+        RegexGroup(RegexArena &, CharClass const&);
 
         void    addChar(char c);
         void    addRangeChar(char from, char to);
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexGroup();
         private:
             void    addChild(RegexComponentBase *);
 
@@ -130,14 +271,13 @@ namespace ft
 
     struct RegexInverseGroup : public RegexComponentBase
     {
-        RegexInverseGroup();
-        RegexInverseGroup(char c);
-        RegexInverseGroup(char from, char to);
+        RegexInverseGroup(RegexArena &);
+        RegexInverseGroup(RegexArena &, char c);
+        RegexInverseGroup(RegexArena &, char from, char to);
+        RegexInverseGroup(RegexArena &, CharClass const&);
 
         void    addChar(char c);
         void    addRangeChar(char from, char to);
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexInverseGroup();
         private:
             void    addChild(RegexComponentBase *);
     };
@@ -149,13 +289,11 @@ namespace ft
 
     struct RegexConcat : public RegexComponentBase
     {
-        RegexConcat();
-        RegexConcat(RegexComponentBase *);
+        RegexConcat(RegexArena &);
+        RegexConcat(RegexArena &, RegexComponentBase *);
 
         void    addChild(RegexComponentBase *child);
 
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexConcat();
         private:
             void    addChar(char);
             void    addRangeChar(char, char);
@@ -166,12 +304,10 @@ namespace ft
 
     struct RegexAlternate : public RegexComponentBase
     {
-        RegexAlternate();
-        RegexAlternate(RegexComponentBase *);
+        RegexAlternate(RegexArena &);
+        RegexAlternate(RegexArena &, RegexComponentBase *);
 
         void    addChild(RegexComponentBase *child);
-        ~RegexAlternate();
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
         private:
             void    addChar(char);
             void    addRangeChar(char, char);
@@ -183,13 +319,10 @@ namespace ft
 
     struct RegexRepeat : public RegexComponentBase
     {
-        RegexRepeat(RepeatedRange);
-        RegexRepeat(RegexComponentBase *child1, unsigned long long min,
+        RegexRepeat(RegexArena &, RepeatedRange);
+        RegexRepeat(RegexArena &, RegexComponentBase *child1, unsigned long long min,
             unsigned long long max);
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexRepeat();
         private:
-            RegexRepeat();
             void    addChild(RegexComponentBase *child);
             void    addChar(char);
             void    addRangeChar(char, char);
@@ -197,13 +330,10 @@ namespace ft
 
     struct RegexRepeatLazy : public RegexComponentBase
     {
-        RegexRepeatLazy(RepeatedRange);
-        RegexRepeatLazy(RegexComponentBase *child1, unsigned long long min,
+        RegexRepeatLazy(RegexArena &, RepeatedRange);
+        RegexRepeatLazy(RegexArena &, RegexComponentBase *child1, unsigned long long min,
             unsigned long long max);
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexRepeatLazy();
         private:
-            RegexRepeatLazy();
             void    addChild(RegexComponentBase *child);
             void    addChar(char);
             void    addRangeChar(char, char);
@@ -212,38 +342,21 @@ namespace ft
 
     struct RegexStartOfGroup : public RegexComponentBase
     {
-        RegexStartOfGroup();
-
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        void    capture(const char *end);
-    
-        std::pair <const char *, const char *> getCapturedGroup() const;
-        ~RegexStartOfGroup();
-        private:
-            void    addChild(RegexComponentBase *child);
-            void    addChar(char);
-            void    addRangeChar(char, char);
-    };
+        RegexStartOfGroup(RegexArena &, size_t id);
 
-    struct RegexEndOfGroup : public RegexComponentBase
-    {
-        RegexEndOfGroup(RegexStartOfGroup *);
+        // index of the group in Regex::inner_groups (0 is the whole match)
+        size_t  id;
 
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexEndOfGroup();
         private:
-            RegexEndOfGroup();
             void    addChild(RegexComponentBase *child);
             void    addChar(char);
             void    addRangeChar(char, char);
     };
 
-    struct RegexEnd : public RegexComponentBase
+    struct RegexEndOfGroup : public RegexComponentBase
     {
-        RegexEnd();
+        RegexEndOfGroup(RegexArena &, RegexStartOfGroup *);
 
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexEnd();
         private:
             void    addChild(RegexComponentBase *child);
             void    addChar(char);
@@ -253,12 +366,9 @@ namespace ft
 
     struct RegexBackReference : public RegexComponentBase
     {
-        RegexBackReference(RegexStartOfGroup *);
+        RegexBackReference(RegexArena &, RegexStartOfGroup *);
 
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexBackReference();
         private:
-            RegexBackReference();
             void    addChild(RegexComponentBase *child);
             void    addChar(char);
             void    addRangeChar(char, char);
@@ -266,11 +376,8 @@ namespace ft
 
     struct RegexStartOfLine : public RegexComponentBase
     {
-        RegexStartOfLine();
+        RegexStartOfLine(RegexArena &);
 
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        void    setStart(const char *start);
-        ~RegexStartOfLine();
         private:
             void    addChild(RegexComponentBase *child);
             void    addChar(char);
@@ -279,10 +386,8 @@ namespace ft
 
     struct RegexEndOfLine : public RegexComponentBase
     {
-        RegexEndOfLine();
+        RegexEndOfLine(RegexArena &);
 
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexEndOfLine();
         private:
             void    addChild(RegexComponentBase *child);
             void    addChar(char);
@@ -291,10 +396,8 @@ namespace ft
 
     struct RegexWordBoundary : public RegexComponentBase
     {
-        RegexWordBoundary();
+        RegexWordBoundary(RegexArena &);
 
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
-        ~RegexWordBoundary();
         private:
             void    addChild(RegexComponentBase *child);
             void    addChar(char);
@@ -303,9 +406,7 @@ namespace ft
 
     struct RegexNonWordBoundary : public RegexComponentBase
     {
-        RegexNonWordBoundary();
-        ~RegexNonWordBoundary();
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
+        RegexNonWordBoundary(RegexArena &);
 
         private:
             void    addChild(RegexComponentBase *child);
@@ -315,9 +416,7 @@ namespace ft
 
     struct RegexPositiveLookBehind : public RegexComponentBase
     {
-        RegexPositiveLookBehind();
-        ~RegexPositiveLookBehind();
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
+        RegexPositiveLookBehind(RegexArena &);
 
         private:
             void    addChild(RegexComponentBase *child);
@@ -327,9 +426,7 @@ namespace ft
 
     struct RegexNegativeLookBehind : public RegexComponentBase
     {
-        RegexNegativeLookBehind();
-        ~RegexNegativeLookBehind();
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
+        RegexNegativeLookBehind(RegexArena &);
 
         private:
             void    addChild(RegexComponentBase *child);
@@ -339,9 +436,7 @@ namespace ft
 
     struct RegexPositiveLookAhead : public RegexComponentBase
     {
-        RegexPositiveLookAhead();
-        ~RegexPositiveLookAhead();
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
+        RegexPositiveLookAhead(RegexArena &);
 
         private:
             void    addChild(RegexComponentBase *child);
@@ -351,9 +446,7 @@ namespace ft
 
     struct RegexNegativeLookAhead : public RegexComponentBase
     {
-        RegexNegativeLookAhead();
-        ~RegexNegativeLookAhead();
-        bool    match(const char *&, unsigned long long, MatchInfo *, Functor*, const char* = NULL) const;
+        RegexNegativeLookAhead(RegexArena &);
 
         private:
             void    addChild(RegexComponentBase *child);
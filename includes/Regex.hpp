@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../RegexUtils.hpp"
+#include "../RegexProgram.hpp"
 #include <string>
 #include <cstring>
 #include <cstdlib>
@@ -8,6 +9,7 @@
 #include <limits>
 #include <exception>
 #include <iostream>
+#include <pthread.h>
 
 namespace ft
 {
@@ -44,7 +46,13 @@ class Regex
     std::string     regex;
     unsigned int    flags;
     std::string::const_iterator current;
+    RegexArena          arena;              // holds every component of root
     RegexComponentBase* root;
+    RegexProgram*       program;
+    RegexProgram*       reverseProgram;     // built when every match ends with $
+    size_t              dfaBudget;
+    size_t              backtrackLimit;
+    size_t              memoLimit;
     static const long long Infinity = __LONG_LONG_MAX__;
     static const long long MaxRepeat = 1024;
     std::vector <RegexStartOfGroup *>   inner_groups;
@@ -56,6 +64,61 @@ class Regex
         RegexComponentBase* c;
         ret_t(CustomLongLong , CustomLongLong , RegexComponentBase* );
     };
+    // what a thread needs to run this regex: its own DFA cache,
+    // backtracking stack and capture buffers
+    struct scratch_t
+    {
+        RegexLazyDFA                                        *dfa;
+        RegexLazyDFA                                        *reverseDFA;
+        size_t                                              budget;
+        RegexBacktracker                                    *backtracker;
+        size_t                                              limit;
+        size_t                                              memoLimit;
+        RegexPikeVM                                         *pike;
+        std::vector<const char *>                           slots;
+
+        scratch_t();
+        ~scratch_t();
+    };
+    // The scratch of a regex not used at the moment. A call takes one or
+    // makes a new one and gives it back when it returns, so there are as
+    // many as the threads that ran the regex at once, and they are freed
+    // with the regex
+    struct pool_t
+    {
+        pthread_mutex_t             lock;
+        std::vector<scratch_t *>    idle;
+
+        pool_t();
+        ~pool_t();
+        scratch_t   *take();
+        void        give(scratch_t *);
+        void        clear();
+
+        private:
+            pool_t(pool_t const&);
+            pool_t &operator=(pool_t const&);
+    };
+    // a scratch of the pool for the time of a call, ready to run the regex
+    // when it is given one
+    struct lease_t
+    {
+        pool_t      &pool;
+        scratch_t   &scratch;
+
+        lease_t(pool_t &);
+        lease_t(Regex const&);
+        ~lease_t();
+    };
+    mutable pool_t      pool;
+
+    friend class MatchIterator;
+    friend class RegexSet;
+    friend class RegexImage;
+    friend class RegexStream;
+
+    Regex(const std::string &regex, unsigned int flags, RegexProgram *program,
+        RegexProgram *reverseProgram);
 
 public:
     struct  result_t
@@ -63,19 +126,145 @@ public:
         std::string str;
         std::vector<std::string> groups;
     };
+
+    // Work a tryMatch() may do: steps are the alternatives taken and
+    // undone by the backtracking, the deadline is a gettimeofday() time.
+    // 0 does not limit anything
+    struct  limit_t
+    {
+        size_t          steps;
+        struct timeval  deadline;
+
+        limit_t(size_t steps = 0);
+        // sets the deadline ms milliseconds from now
+        void            timeout(unsigned long ms);
+    };
+
+    // results of tryMatch()
+    enum
+    {
+        NoMatch,
+        Match,
+        Aborted,    // the limit was exceeded before the match was decided
+    };
+
+    // A match as the bounds of its groups in the input, nothing is
+    // copied. Reusing the same match_t does not allocate once it has
+    // held a match of the regex; the input must outlive it
+    struct  match_t
+    {
+        const char                  *data;      // start of the input
+        std::vector<const char *>   slots;      // group id is [2 * id, 2 * id + 1]
+
+        match_t();
+        // the groups of the match, 0 is the whole match
+        size_t          groups() const;
+        // an unset group is empty
+        const char      *begin(size_t id = 0) const;
+        const char      *end(size_t id = 0) const;
+        size_t          position(size_t id = 0) const;
+        size_t          length(size_t id = 0) const;
+        std::string     str(size_t id = 0) const;
+    };
+
+    // A column of strings laid out like Arrow's: the bytes of the rows one
+    // after the other and rows + 1 offsets, row i is
+    // data[offsets[i], offsets[i + 1]). Nothing is copied
+    struct  column_t
+    {
+        const char          *data;
+        const int           *offsets32;     // one of them is NULL
+        const long long     *offsets64;
+        size_t              rows;
+
+        column_t(const char *data, const int *offsets, size_t rows);
+        column_t(const char *data, const long long *offsets, size_t rows);
+        const char          *begin(size_t row) const;
+        const char          *end(size_t row) const;
+    };
+
+    // What profile() counted in each component of the pattern. The
+    // counts of the copies of a counted repeat are added up
+    struct  profile_t
+    {
+        struct  node_t
+        {
+            std::string         kind;       // "alternate", "repeat {2,5}"...
+            size_t              depth;      // 0 for the root
+            size_t              begin;      // the bytes of the pattern it was parsed
+            size_t              end;        // from, none for group 0 (begin == end)
+            unsigned long long  entered;
+            unsigned long long  succeeded;  // left for the rest of the pattern
+            unsigned long long  failures;   // backtracks started in it
+            unsigned long long  retries;    // alternatives it left that a failure took
+            unsigned long long  steps;      // instructions run in it
+        };
+
+        std::string             pattern;
+        std::vector<node_t>     nodes;      // depth first, the root first
+        unsigned long long      starts;     // positions a match was tried at
+        int                     result;     // Match, NoMatch or Aborted
+
+        // the tree of the pattern, a component per line after its counts
+        void                    dump(std::ostream &) const;
+    };
     
+    // once built a Regex is not modified by matching, the same instance
+    // can be used by several threads at once
     Regex(const std::string &regex, unsigned int = 0);
     ~Regex();
-    bool                        match(std::string const&, result_t &);
-    bool                        match(const char *, result_t &);
-    std::vector<result_t>       matchAll(std::string const&);
-    std::vector<result_t>       matchAll(const char*);
-    bool                        test(std::string const&);
-    bool                        test(const char*);
+    bool                        match(std::string const&, result_t &) const;
+    bool                        match(const char *, result_t &) const;
+    std::vector<result_t>       matchAll(std::string const&) const;
+    std::vector<result_t>       matchAll(const char*) const;
+    bool                        test(std::string const&) const;
+    bool                        test(const char*) const;
+    // the len bytes at data are matched, they may contain '\0'
+    bool                        match(const char *data, size_t len, result_t &) const;
+    bool                        match(const char *data, size_t len, match_t &) const;
+    // like match() but gives up once the limit is exceeded, returns
+    // Match, NoMatch or Aborted
+    int                         tryMatch(const char *data, size_t len, match_t &,
+                                    limit_t const&) const;
+    std::vector<result_t>       matchAll(const char *data, size_t len) const;
+    bool                        test(const char *data, size_t len) const;
+    // test() of every row of the column: bit i % 8 of mask[i / 8] is set
+    // if row i matches, the bit order of Arrow's validity bitmaps. Returns
+    // the number of matching rows. Batches of more than MinRowsPerThread
+    // rows are cut in slices run by up to threads threads, what a slice
+    // throws is thrown again once they are all joined
+    size_t                      filter(column_t const&, std::vector<unsigned char> &mask,
+                                    size_t threads = 1) const;
+    // the ids of the matching rows in increasing order
+    size_t                      select(column_t const&, std::vector<size_t> &selection,
+                                    size_t threads = 1) const;
+    // memory each thread's DFA cache may use before being flushed, 0
+    // disables the DFA. Must not be called while another thread is matching
+    void                        setDFABudget(size_t);
+    // memory each thread's backtracking stack may use, above it match()
+    // falls back to the Pike VM, with the same result, or throws
+    // BacktrackLimitException if the regex has back-references or
+    // counted loops
+    void                        setBacktrackLimit(size_t);
+    // memory each thread's backtracker may use to remember the states that
+    // failed, a match needing more runs without it (0 disables it)
+    void                        setMemoLimit(size_t);
+    // match() run by the backtracker alone (without the DFA nor the Pike
+    // VM) counting what it does in each component of the pattern. The
+    // counting is compiled in this call only, the other ones do not pay
+    // for it. Returns Match, NoMatch or Aborted like tryMatch(); a regex
+    // loaded from an image has no components, std::logic_error is thrown
+    int                         profile(const char *data, size_t len, profile_t &,
+                                    limit_t const& = limit_t()) const;
+    // bytes taken from the heap by the compiled regex: its components
+    // and programs, the scratch of the threads running it is not counted
+    size_t                      memoryUsage() const;
     enum 
     {
         iCase = 4,
+        pikeVM = 8,     // linear time matching, ignored if the regex has back-references
     };
+    static const size_t         MinRowsPerThread = 4096;
     
 private:
     char                    peek();
@@ -98,18 +287,74 @@ private:
     RegexComponentBase*     charGroupBody(RegexComponentBase*);
     RegexComponentBase*     charGroupSkiped(char, RegexComponentBase*);
     RegexComponentBase*     charGroupRange(char, RegexComponentBase*);
+    RegexComponentBase*     foldCase(RegexComponentBase*);
 
     ret_t                   repeat(ret_t, long long, long long, bool = true);
     ret_t                   repeat(ret_t, char);
     ret_t                   concat(ret_t, ret_t);
     ret_t                   alter(ret_t, ret_t);
+    // offset of the next character of the pattern
+    size_t                  offset() const;
+    // the component of ret was parsed from [begin, offset())
+    ret_t                   spanned(ret_t ret, size_t begin);
 
     RegexComponentBase*     construct_skiped_char();
     ret_t                   expr_without_repeat();
 
     RegexComponentBase      *parse();
 
+    // rows [begin, end) of a filter(), begin is a multiple of 8 so the
+    // slices write their own bytes of the mask
+    struct slice_t
+    {
+        Regex const         *regex;
+        column_t const      *column;
+        unsigned char       *mask;
+        size_t              begin;
+        size_t              end;
+        size_t              count;      // matching rows
+        int                 error;      // what the thread threw, 0 if nothing
+    };
+    int                     search(const char *startOfStr, const char *endOfStr,
+                                const char *from, std::vector<const char *> &slots,
+                                RegexBudget *budget = NULL) const;
+    int                     search(scratch_t &, const char *startOfStr,
+                                const char *endOfStr, const char *from,
+                                std::vector<const char *> &slots,
+                                RegexBudget *budget = NULL) const;
+    bool                    test(scratch_t &, const char *data, size_t len) const;
+    void                    fillResult(std::vector<const char *> const&, result_t &) const;
+    void                    prepare(scratch_t &) const;
+    void                    filterSlice(slice_t &) const;
+    static void             *runSlice(void *);
+
 public:
+    // Finds the matches of a regex one after the other, each search
+    // resumes where the previous match ended so the input is read once.
+    // The input must outlive the iterator
+    //     Regex::MatchIterator it(r, data, len);
+    //     while (it.next())
+    //         use(it.result().position(), it.result().length());
+    class MatchIterator
+    {
+        Regex const&    regex;
+        const char      *endOfStr;
+        const char      *pos;       // NULL once the input is exhausted
+        match_t         current;
+
+    public:
+        MatchIterator(Regex const&, const char *data, size_t len);
+
+        // false when there is no match left
+        bool            next();
+        // the next search starts at pos instead, a position of the input
+        // (a line after the one that matched); the bytes before it are
+        // still seen by ^, \b and the look-behinds
+        void            seek(const char *pos);
+        // the current match, overwritten by next()
+        match_t const&  result() const;
+    };
+
     class InvalidRegexException : public std::exception
     {
         const char* error;
@@ -117,6 +362,12 @@ public:
         InvalidRegexException(const char* error);
         const char* what() const throw();
     };
+
+    class BacktrackLimitException : public std::exception
+    {
+    public:
+        const char* what() const throw();
+    };
 };
 
 } // namespace ft
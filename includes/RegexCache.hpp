@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Regex.hpp"
+#include <map>
+#include <list>
+#include <pthread.h>
+
+namespace ft
+{
+
+// Compiled regexes kept by (pattern, flags), the least recently used
+// one is dropped once the cache holds capacity of them.
+// get() hands out a Handle sharing the cached Regex: nothing is copied
+// nor compiled again, and the Regex lives until its last handle is
+// destroyed even if the cache dropped it. Regexes being read-only once
+// built, the handles can be used by several threads at once
+//     ft::RegexCache::Handle r = ft::RegexCache::global().get(pattern);
+//     r->test(line);
+class RegexCache
+{
+    typedef std::pair<std::string, unsigned int>    pattern_t;
+
+    struct entry_t
+    {
+        Regex                               *regex;
+        pattern_t                           key;
+        int                                 refs;   // handles + 1 while cached
+        std::list<entry_t *>::iterator      lru;
+
+        entry_t(Regex *, pattern_t const&);
+        ~entry_t();
+    };
+
+    typedef std::map<pattern_t, entry_t *>  map_t;
+
+    map_t                   entries;
+    std::list<entry_t *>    lru;            // most recent first
+    size_t                  capacity;
+    size_t                  hitCount;
+    size_t                  missCount;
+    mutable pthread_mutex_t lock;
+
+    static void             release(entry_t *);
+    void                    evict(size_t keep);
+
+public:
+    class Handle
+    {
+        entry_t     *entry;
+
+        friend class RegexCache;
+        Handle(entry_t *);
+
+    public:
+        Handle();
+        Handle(Handle const&);
+        Handle &operator=(Handle const&);
+        ~Handle();
+
+        Regex const&    operator*() const;
+        Regex const*    operator->() const;
+        Regex const*    get() const;    // NULL for a default constructed handle
+    };
+
+    static const size_t     DefaultCapacity = 256;
+
+    RegexCache(size_t capacity = DefaultCapacity);
+    ~RegexCache();
+
+    // the cache shared by the whole process
+    static RegexCache       &global();
+
+    // the regex of pattern, compiled on a miss; throws
+    // Regex::InvalidRegexException like the Regex constructor, the
+    // invalid patterns are not cached
+    Handle                  get(std::string const& pattern, unsigned int flags = 0);
+    size_t                  hits() const;
+    size_t                  misses() const;
+    size_t                  size() const;
+    // drops the least recently used regexes above capacity
+    void                    setCapacity(size_t);
+    void                    clear();
+
+private:
+    RegexCache(RegexCache const&);
+    RegexCache &operator=(RegexCache const&);
+};
+
+} // namespace ft
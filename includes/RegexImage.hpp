@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Regex.hpp"
+#include "RegexSet.hpp"
+
+namespace ft
+{
+
+// Compiled regexes saved to a file and loaded without being parsed nor
+// compiled again: the file is mapped read-only and the instructions and
+// character classes of the programs are used where they lie in it, so
+// processes loading the same file share its pages.
+// The file records its version and byte order, a file written by another
+// version of the library is rejected rather than misread
+//     ft::RegexImage::write("patterns.bin", regexes);
+//     ...
+//     ft::RegexImage image("patterns.bin");
+//     image[0].test(line);
+// The regexes of an image are destroyed with it
+class RegexImage
+{
+    const char              *data;
+    size_t                  length;
+    std::vector<Regex *>    regexes;
+    RegexSet                *loadedSet;     // owns the regexes when not NULL
+
+    void                    load();
+    void                    release();
+    RegexProgram            *loadProgram(size_t offset) const;
+    template<class T>
+    T const                 *at(size_t offset, size_t count = 1) const;
+    static void             save(std::string const& path,
+                                std::vector<Regex const *> const& regexes, RegexSet const *);
+
+public:
+    static const unsigned int   Version = 2;
+
+    // maps the file, throws InvalidImageException if it is not an image
+    // of this version and std::runtime_error if it cannot be read
+    RegexImage(std::string const& path);
+    ~RegexImage();
+
+    static void             write(std::string const& path,
+                                std::vector<Regex const *> const& regexes);
+    // the set is saved with its combined program, compile() must have
+    // been called
+    static void             write(std::string const& path, RegexSet const&);
+
+    // the regexes in the order they were written
+    size_t                  size() const;
+    Regex                   &operator[](size_t id);
+    Regex const&            operator[](size_t id) const;
+    // the set the image was written from, NULL if it was written from a
+    // list of regexes
+    RegexSet const          *set() const;
+
+    class InvalidImageException : public std::exception
+    {
+        const char* error;
+    public:
+        InvalidImageException(const char* error);
+        const char* what() const throw();
+    };
+
+private:
+    RegexImage(RegexImage const&);
+    RegexImage &operator=(RegexImage const&);
+};
+
+} // namespace ft
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Regex.hpp"
+
+namespace ft
+{
+
+// Many regexes matched at once: their programs are combined into one
+// that the lazy DFA runs in a single pass over the input, so the time
+// per byte does not grow with the number of patterns. The patterns the
+// DFA cannot run (back-references, look-arounds) are tested one by one.
+// The patterns are add()ed then compile() is called once; like a Regex,
+// a compiled set can be used by several threads at once
+class RegexSet
+{
+    std::vector<Regex *>    regexes;
+    std::vector<size_t>     combined;   // ids of the patterns in program
+    std::vector<size_t>     others;     // ids of the patterns tested one by one
+    RegexProgram            *program;
+    size_t                  dfaBudget;
+    mutable Regex::pool_t   pool;       // the scratch hold the DFA of program
+
+    friend class RegexImage;
+
+public:
+    // the states of a set hold the threads of every pattern, they are
+    // larger than the ones of a single regex
+    static const size_t     DefaultBudget = 1 << 24;
+
+    RegexSet();
+    ~RegexSet();
+
+    // returns the id of the pattern (ids count from 0 in the order the
+    // patterns are added), throws Regex::InvalidRegexException
+    size_t                  add(std::string const& pattern, unsigned int flags = 0);
+    // builds the combined program, must not be called while another
+    // thread is matching
+    void                    compile();
+    size_t                  size() const;
+    // the regex of a pattern, to extract the groups of the ones that hit
+    Regex const&            operator[](size_t id) const;
+
+    // ids receives the ids of the patterns matching somewhere in the
+    // input, in increasing order
+    bool                    test(const char *data, size_t len, std::vector<size_t> &ids) const;
+    bool                    test(std::string const&, std::vector<size_t> &ids) const;
+    // memory each thread's DFA cache may use before being flushed
+    void                    setDFABudget(size_t);
+
+private:
+    RegexSet(RegexSet const&);
+    RegexSet &operator=(RegexSet const&);
+};
+
+} // namespace ft
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Regex.hpp"
+
+namespace ft
+{
+
+// Matches a regex against a stream received in chunks, without keeping
+// the chunks: the lazy DFA state reached at the end of a chunk is kept
+// and the next one resumes from it, so the memory used does not depend
+// on the length of the stream. The offset, counted from the start of
+// the stream, of every position a match ends at is reported once;
+// matches may overlap (a+ on "aaa" ends at 1, 2 and 3).
+// Only the regexes the DFA runs can be streamed: no back-references,
+// look-arounds, counted loops too large to be expanded nor repeats whose
+// empty iterations depend on an assertion ((?:\ba*){2})
+//     ft::RegexStream stream(r);
+//     while (read(fd, buf, size) > 0)
+//         stream.feed(buf, n, ends);
+//     stream.finish(ends);
+// A stream is used by one thread at a time, the regex can be shared by
+// the streams of several threads
+class RegexStream
+{
+    Regex const&            regex;
+    RegexLazyDFA::Cursor    cursor;
+
+    static RegexLazyDFA     &dfa(Regex::lease_t const&);
+
+public:
+    typedef unsigned long long  offset_t;
+
+    // throws std::invalid_argument if the regex cannot be streamed or its
+    // DFA budget is 0
+    RegexStream(Regex const&);
+
+    static bool             supports(Regex const&);
+
+    // ends receives the matches ending in the chunk. A match ending at
+    // the end of a chunk is reported by the next call: $ and \b depend
+    // on the byte after it
+    bool                    feed(const char *data, size_t len, std::vector<offset_t> &ends);
+    bool                    feed(std::string const&, std::vector<offset_t> &ends);
+    // the end of the stream, ends receives a match ending at its last byte
+    bool                    finish(std::vector<offset_t> &ends);
+    // starts a new stream
+    void                    reset();
+    // bytes fed since the start of the stream
+    offset_t                offset() const;
+};
+
+} // namespace ft
@@ -0,0 +1,264 @@
+#include <Regex.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <time.h>
+#include <unistd.h>
+
+// regex_bench [-s samples] [-o baseline] [-c baseline] [-t percent] [filter]
+// Times the compiling and the matching of a fixed list of cases. Each
+// measure is warmed up, then taken as samples of repeats lasting about
+// SampleNs each; the median and the 99th percentile of the time of one
+// repeat are reported. -o saves the results to a baseline file, -c
+// compares them to a saved baseline and exits with 1 if a median got
+// slower by more than -t percent (10 by default). Only the cases whose
+// name contains filter are run
+
+static const double     SampleNs = 50000;
+static const double     WarmupNs = 20000000;
+
+struct case_t
+{
+    const char      *name;
+    const char      *pattern;
+    unsigned int    flags;
+    const char      *text;
+    size_t          times;      // the input is text repeated times times
+};
+
+static const case_t     cases[] = {
+    { "words", "(\\w+)\\s(\\w+)\\s(\\w+)", 0, "Hello\tWorld Again", 1 },
+    { "ipv4", "\\b(?:(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?)\\.){3}(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?)\\b", 0,
+        "this is my not and ip: 192.168.1.999 but this an  ip: 192.168.1.1", 1 },
+    { "ipv6", "(([0-9a-fA-F]{1,4}:){7,7}[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,7}:|([0-9a-fA-F]{1,4}:){1,6}:[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,5}(:[0-9a-fA-F]{1,4}){1,2}|([0-9a-fA-F]{1,4}:){1,4}(:[0-9a-fA-F]{1,4}){1,3}|([0-9a-fA-F]{1,4}:){1,3}(:[0-9a-fA-F]{1,4}){1,4}|([0-9a-fA-F]{1,4}:){1,2}(:[0-9a-fA-F]{1,4}){1,5}|[0-9a-fA-F]{1,4}:((:[0-9a-fA-F]{1,4}){1,6})|:((:[0-9a-fA-F]{1,4}){1,7}|:)|fe80:(:[0-9a-fA-F]{0,4}){0,4}%[0-9a-zA-Z]{1,}|::(ffff(:0{1,4}){0,1}:){0,1}((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])|([0-9a-fA-F]{1,4}:){1,4}:((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9]))", 0,
+        "this is not an ip v6 m001:dbZ8:3333:4444:5555:6666:7777:8888 but this is 2001:db8:3333:4444:CCCC:DDDD:EEEE:FFFF", 1 },
+    { "url", "https?:\\/\\/(?:[-\\w]+\\.)?([-\\w]+)\\.\\w+(?:\\.\\w+)?\\/?.*", 0,
+        "https://www.google.com/search?q=this+is+not+an+ip", 1 },
+    { "phone", "\\+?\\d{1,3}?[- .]?\\(?(?:\\d{2,3})\\)?[- .]?\\d\\d\\d[- .]?\\d\\d\\d\\d", 0, "123.456.7890", 1 },
+    { "date", "(?:(?:31(\\/|-|\\.)(?:0?[13578]|1[02]))\\1|(?:(?:29|30)(\\/|-|\\.)(?:0?[1,3-9]|1[0-2])\\2))(?:(?:1[6-9]|[2-9]\\d)?\\d{2})$|^(?:29(\\/|-|\\.)0?2\\3(?:(?:(?:1[6-9]|[2-9]\\d)?(?:0[48]|[2468][048]|[13579][26])|(?:(?:16|[2468][048]|[3579][26])00))))$|^(?:0?[1-9]|1\\d|2[0-8])(\\/|-|\\.)(?:(?:0?[1-9])|(?:1[0-2]))\\4(?:(?:1[6-9]|[2-9]\\d)?\\d{2})", 0,
+        "31/12/2014", 1 },
+    { "card", "\\b(?:4[0-9]{12}(?:[0-9]{3})?|5[1-5][0-9]{14}|6(?:011|5[0-9][0-9])[0-9]{12}|3[47][0-9]{13}|3(?:0[0-5]|[68][0-9])[0-9]{11}|(?:2131|1800|35\\d{3})\\d{11})\\b", 0,
+        "When a random word or a random sentence isn't quite enough, the 4650398256543094 next logical step", 1 },
+    { "text-literal", "needle", 0, "a haystack line without what is looked for\n", 24000 },
+    { "text-email", "\\b(\\w+)@(\\w+)\\.com\\b", 0, "some text around john at example dot com and more text.\n", 18000 },
+    { "text-icase", "error: (\\w+) failed", ft::Regex::iCase, "INFO: request 4242 served in 12ms\n", 30000 },
+    { "text-lines", "^[a-z]+=\\d+$", 0, "key = value, not an assignment\n", 33000 },
+};
+
+enum
+{
+    Compile,
+    Test,
+    Match,
+};
+
+static const char   *phases[] = { "compile", "test", "match" };
+
+struct result_t
+{
+    std::string     key;        // case/phase
+    double          median;     // ns for one repeat
+    double          p99;
+    size_t          bytes;      // 0 when compiling
+};
+
+static double   now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile size_t  sink;   // keeps the calls from being optimized away
+
+// runs the phase repeats times, returns the ns it took
+static double   run(case_t const& c, int phase, ft::Regex const& r, std::string const& input,
+    ft::Regex::match_t &m, size_t repeats)
+{
+    double  start = now();
+
+    for (size_t i = 0; i < repeats; i++)
+    {
+        if (phase == Compile)
+        {
+            ft::Regex   compiled(c.pattern, c.flags);
+            sink += compiled.memoryUsage();
+        }
+        else if (phase == Test)
+            sink += r.test(input.data(), input.size());
+        else
+            sink += r.match(input.data(), input.size(), m);
+    }
+    return now() - start;
+}
+
+static result_t     measure(case_t const& c, int phase, ft::Regex const& r,
+    std::string const& input, size_t samples)
+{
+    ft::Regex::match_t  m;
+    double              warm = 0;
+    size_t              runs = 0;
+
+    // the first calls build the scratch and fill the DFA cache
+    while (warm < WarmupNs || runs < 10)
+    {
+        warm += run(c, phase, r, input, m, 1);
+        runs++;
+    }
+    size_t  repeats = std::max(1.0, SampleNs / (warm / runs));
+
+    std::vector<double> times(samples);
+    for (size_t i = 0; i < samples; i++)
+        times[i] = run(c, phase, r, input, m, repeats) / repeats;
+    std::sort(times.begin(), times.end());
+
+    result_t    res;
+    res.key = std::string(c.name) + "/" + phases[phase];
+    res.median = times[samples / 2];
+    res.p99 = times[(samples * 99 + 99) / 100 - 1];
+    res.bytes = phase == Compile ? 0 : input.size();
+    return res;
+}
+
+static void     print(result_t const& res)
+{
+    std::printf("%-22s %12.1f %12.1f", res.key.c_str(), res.median, res.p99);
+    if (res.bytes)
+        std::printf(" %10.3f %10.1f\n", res.median / res.bytes, res.bytes * 1000.0 / res.median);
+    else
+        std::printf(" %10s %10s\n", "-", "-");
+}
+
+static bool     save(std::string const& path, std::vector<result_t> const& results)
+{
+    std::ofstream   out(path.c_str());
+
+    out << std::fixed;
+    out.precision(1);
+    out << "# regex_bench baseline: key median_ns p99_ns bytes\n";
+    for (size_t i = 0; i < results.size(); i++)
+        out << results[i].key << '\t' << results[i].median << '\t'
+            << results[i].p99 << '\t' << results[i].bytes << '\n';
+    return static_cast<bool>(out.flush());
+}
+
+static bool     load(std::string const& path, std::map<std::string, result_t> &baseline)
+{
+    std::ifstream   in(path.c_str());
+    std::string     line;
+
+    if (!in)
+        return false;
+    while (std::getline(in, line))
+    {
+        std::istringstream  fields(line);
+        result_t            res;
+
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (fields >> res.key >> res.median >> res.p99 >> res.bytes)
+            baseline[res.key] = res;
+    }
+    return true;
+}
+
+// the regressions found
+static int  compare(std::map<std::string, result_t> const& baseline,
+    std::vector<result_t> const& results, double threshold)
+{
+    int regressions = 0;
+
+    std::printf("\n%-22s %12s %12s %9s\n", "vs baseline", "base ns", "now ns", "change");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        std::map<std::string, result_t>::const_iterator it = baseline.find(results[i].key);
+        if (it == baseline.end())
+        {
+            std::printf("%-22s %12s %12.1f %9s\n", results[i].key.c_str(), "-",
+                results[i].median, "new");
+            continue;
+        }
+        double  change = (results[i].median / it->second.median - 1) * 100;
+        bool    slower = change > threshold;
+        std::printf("%-22s %12.1f %12.1f %+8.1f%%%s\n", results[i].key.c_str(),
+            it->second.median, results[i].median, change, slower ? "  REGRESSION" : "");
+        regressions += slower;
+    }
+    return regressions;
+}
+
+static int      usage()
+{
+    std::fprintf(stderr, "usage: regex_bench [-s samples] [-o baseline] [-c baseline]"
+        " [-t percent] [filter]\n"
+        "  -s  samples per measure (101 by default)\n"
+        "  -o  save the results to baseline\n"
+        "  -c  compare the results to baseline, exit with 1 on a regression\n"
+        "  -t  slowdown of a median counted as a regression, in percent (10)\n");
+    return 2;
+}
+
+int main(int ac, char **av)
+{
+    size_t      samples = 101;
+    std::string output, against;
+    double      threshold = 10;
+    int         opt;
+
+    while ((opt = getopt(ac, av, "s:o:c:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': samples = std::max(1L, std::strtol(optarg, NULL, 10)); break;
+        case 'o': output = optarg; break;
+        case 'c': against = optarg; break;
+        case 't': threshold = std::strtod(optarg, NULL); break;
+        default: return usage();
+        }
+    }
+    if (ac - optind > 1)
+        return usage();
+    const char  *filter = optind < ac ? av[optind] : "";
+
+    std::map<std::string, result_t>    baseline;
+    if (!against.empty() && !load(against, baseline))
+    {
+        std::fprintf(stderr, "regex_bench: cannot read %s\n", against.c_str());
+        return 2;
+    }
+
+    std::vector<result_t>   results;
+    std::printf("%-22s %12s %12s %10s %10s\n", "case", "median ns", "p99 ns", "ns/byte", "MB/s");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++)
+    {
+        case_t const&   c = cases[i];
+        if (!std::strstr(c.name, filter))
+            continue;
+        std::string input;
+        for (size_t j = 0; j < c.times; j++)
+            input += c.text;
+        ft::Regex   r(c.pattern, c.flags);
+        for (int phase = Compile; phase <= Match; phase++)
+        {
+            results.push_back(measure(c, phase, r, input, samples));
+            print(results.back());
+            std::fflush(stdout);
+        }
+    }
+
+    int status = 0;
+    if (!against.empty() && compare(baseline, results, threshold))
+        status = 1;
+    if (!output.empty() && !save(output, results))
+    {
+        std::fprintf(stderr, "regex_bench: cannot write %s\n", output.c_str());
+        return 2;
+    }
+    return status;
+}
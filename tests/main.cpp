@@ -1,14 +1,24 @@
 #include <Regex.hpp>
+#include <RegexCache.hpp>
+#include <RegexImage.hpp>
+#include <RegexStream.hpp>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
 #include <iostream>
 #include <ctime>
+#include <pthread.h>
+#include <sys/time.h>
 
-void    print_match(ft::Regex r, const char *str)
+void    print_match(ft::Regex &r, const char *str)
 {
-    
-    if (r.match(str))
+    ft::Regex::result_t res;
+
+    if (r.match(str, res))
     {
-        for (size_t i = 0; i < r.groups.size(); i++)
-            std::cout << r.groups[i] << " | ";
+        for (size_t i = 0; i < res.groups.size(); i++)
+            std::cout << res.groups[i] << " | ";
         std::cout << std::endl;
     }
     else
@@ -18,15 +28,467 @@ void    print_match(ft::Regex r, const char *str)
 void    print_match(const char *regex, const char *str)
 {
     ft::Regex r(regex);
-    
-    if (r.match(str))
+
+    print_match(r, str);
+}
+
+// the match and each of its groups as "position,length", "-" when unset
+std::string spans(ft::Regex const& r, std::string const& str)
+{
+    ft::Regex::match_t  m;
+    std::ostringstream  out;
+
+    if (!r.match(str.data(), str.size(), m))
+        return "no match";
+    for (size_t i = 0; i < m.groups(); i++)
     {
-        for (size_t i = 0; i < r.groups.size(); i++)
-            std::cout << r.groups[i] << " | ";
-        std::cout << std::endl;
+        if (i)
+            out << ' ';
+        if (m.begin(i))
+            out << m.position(i) << ',' << m.length(i);
+        else
+            out << '-';
     }
-    else
-        std::cout << "No match" << std::endl;
+    return out.str();
+}
+
+// true if the stream of str reports some match end, and the end of the
+// match when there is one
+bool    streamed(ft::Regex const& r, const char *str, ft::Regex::match_t const& m,
+    bool matched)
+{
+    ft::RegexStream stream(r);
+    std::vector<ft::RegexStream::offset_t>  ends, last;
+
+    stream.feed(str, std::strlen(str), ends);
+    stream.finish(last);
+    ends.insert(ends.end(), last.begin(), last.end());
+    if (!matched)
+        return !ends.empty();
+    return std::find(ends.begin(), ends.end(), m.position(0) + m.length(0)) != ends.end();
+}
+
+// the Pike VM, run by itself or when the backtracker runs out of stack,
+// must give the same match and groups as the default engine, and the DFA
+// of test(), of a set, of filter() and of a stream must find a match when
+// it does
+bool    compare_engines(const char *regex, const char *str)
+{
+    ft::Regex                   r(regex);
+    ft::Regex                   fallback(regex);
+    size_t                      len = std::strlen(str);
+    int                         offsets[] = { 0, static_cast<int>(len) };
+    ft::Regex::column_t         column(str, offsets, 1);
+    std::vector<unsigned char>  mask;
+    ft::RegexSet                set;
+    std::vector<size_t>         ids;
+    ft::Regex::match_t          m;
+    std::string                 wrong;
+
+    fallback.setBacktrackLimit(1);
+    set.add(regex);
+    set.compile();
+    std::string byDefault = spans(r, str);
+    std::string byPike = spans(ft::Regex(regex, ft::Regex::pikeVM), str);
+    std::string byFallback = spans(fallback, str);
+    bool        matched = r.match(str, len, m);
+
+    if (r.test(str, len) != matched)
+        wrong += " test()";
+    if (set.test(str, len, ids) != matched)
+        wrong += " RegexSet";
+    if ((r.filter(column, mask) == 1) != matched)
+        wrong += " filter()";
+    if (ft::RegexStream::supports(r) && streamed(r, str, m, matched) != matched)
+        wrong += " RegexStream";
+    std::cout << "Engines: " << regex << " on \"" << str << "\" | " << byDefault;
+    if (byPike != byDefault)
+        std::cout << " | pikeVM differs: " << byPike;
+    if (byFallback != byDefault)
+        std::cout << " | fallback differs: " << byFallback;
+    if (!wrong.empty())
+        std::cout << " | wrong:" << wrong;
+    std::cout << std::endl;
+    return byPike == byDefault && byFallback == byDefault && wrong.empty();
+}
+
+// both engines must give the expected match and groups
+bool    expect_spans(const char *regex, const char *str, const char *expected)
+{
+    std::string byDefault = spans(ft::Regex(regex), str);
+
+    if (!compare_engines(regex, str))
+        return false;
+    if (byDefault != expected)
+        std::cout << "Expected: " << expected << std::endl;
+    return byDefault == expected;
+}
+
+// tryMatch() decides the match of str within steps steps, not one less
+bool    expect_steps(const char *regex, const char *str, size_t steps,
+    int expected = ft::Regex::Match)
+{
+    ft::Regex           r(regex);
+    ft::Regex::match_t  m;
+    size_t              len = std::strlen(str);
+    int                 enough = r.tryMatch(str, len, m, ft::Regex::limit_t(steps));
+    // a limit of 0 steps does not limit anything
+    int                 fewer = steps > 1
+        ? r.tryMatch(str, len, m, ft::Regex::limit_t(steps - 1)) : ft::Regex::Aborted;
+
+    if (enough == expected && fewer == ft::Regex::Aborted)
+        return true;
+    std::cout << "Steps: " << regex << " on \"" << str << "\" | " << steps
+        << " steps give " << enough << " | " << steps - 1 << " give " << fewer << std::endl;
+    return false;
+}
+
+// a deadline already reached aborts a match the steps do not limit
+bool    expect_deadline(const char *regex, const char *str)
+{
+    ft::Regex           r(regex);
+    ft::Regex::match_t  m;
+    ft::Regex::limit_t  limit;
+    int                 res;
+
+    limit.timeout(0);
+    res = r.tryMatch(str, std::strlen(str), m, limit);
+    if (res != ft::Regex::Aborted)
+        std::cout << "Deadline: " << regex << " on \"" << str << "\" | gives "
+            << res << std::endl;
+    return res == ft::Regex::Aborted;
+}
+
+// a DFA whose cache is flushed every few states, one giving up for the
+// other engines and no DFA at all find the same match, test() agrees
+bool    expect_dfa_budgets(const char *regex, std::string const& text,
+    std::string const& expected)
+{
+    size_t      budgets[] = { 0, 1, 2048 };
+    ft::Regex   r(regex);
+    std::string wrong;
+
+    if (spans(r, text) != expected)
+        wrong += " default";
+    for (size_t i = 0; i < sizeof(budgets) / sizeof(*budgets); i++)
+    {
+        std::ostringstream  budget;
+        r.setDFABudget(budgets[i]);
+        budget << ' ' << budgets[i];
+        if (spans(r, text) != expected
+            || r.test(text.data(), text.size()) != (expected != "no match"))
+            wrong += budget.str();
+    }
+    std::cout << "DFA budgets: " << regex << " on " << text.size() << " bytes | "
+        << expected;
+    if (!wrong.empty())
+        std::cout << " | wrong:" << wrong;
+    std::cout << std::endl;
+    return wrong.empty();
+}
+
+// the needle put at each offset from 0 to 70 of a text of filler bytes,
+// NULs and near misses of the needle: match(), the Pike VM and test()
+// must find it there and nothing once it is taken out. The texts end at
+// both sides of the 16 and 32 byte blocks the skip loops read
+bool    expect_at_offsets(const char *regex, std::string const& filler,
+    std::string const& needle)
+{
+    ft::Regex           r(regex);
+    ft::Regex           pike(regex, ft::Regex::pikeVM);
+    std::ostringstream  wrong;
+
+    for (size_t at = 0; at <= 70; at++)
+    {
+        std::string         text;
+        std::ostringstream  expected;
+
+        for (size_t i = 0; i < at + at % 17; i++)
+            text += filler[i % filler.size()];
+        text.insert(at, needle);
+        expected << at << ',' << needle.size();
+        if (spans(r, text) != expected.str() || spans(pike, text) != expected.str()
+            || !r.test(text.data(), text.size()))
+            wrong << ' ' << at;
+        text.erase(at, needle.size());
+        if (spans(r, text) != "no match" || spans(pike, text) != "no match"
+            || r.test(text.data(), text.size()))
+            wrong << " -" << at;
+    }
+    std::cout << "Offsets: " << regex << " | needle of " << needle.size() << " bytes";
+    if (!wrong.str().empty())
+        std::cout << " | wrong at:" << wrong.str();
+    std::cout << std::endl;
+    return wrong.str().empty();
+}
+
+// the size bytes of data are matched, NULs included, by each overload
+// taking a length or a std::string
+bool    expect_data(std::string const& regex, std::string const& data,
+    std::string const& expected)
+{
+    ft::Regex           r(regex);
+    ft::Regex           pike(regex, ft::Regex::pikeVM);
+    ft::Regex::match_t  m;
+    ft::Regex::result_t res;
+    bool                matched = r.match(data.data(), data.size(), m);
+    std::string         wrong;
+
+    if (spans(r, data) != expected)
+        wrong += " match()";
+    if (spans(pike, data) != expected)
+        wrong += " pikeVM";
+    if (r.test(data) != matched || r.test(data.data(), data.size()) != matched)
+        wrong += " test()";
+    if (r.match(data, res) != matched || (matched && res.str != m.str()))
+        wrong += " result_t";
+    std::cout << "Data: ";
+    for (size_t i = 0; i < regex.size(); i++)
+        std::cout << (regex[i] ? std::string(1, regex[i]) : "\\0");
+    std::cout << " on " << data.size() << " bytes | " << spans(r, data);
+    if (!wrong.empty())
+        std::cout << " | wrong:" << wrong;
+    std::cout << std::endl;
+    return wrong.empty() && spans(r, data) == expected;
+}
+
+// the matches one after the other as "position,length", each search
+// resumes where the last match ended
+std::string all_spans(ft::Regex const& r, std::string const& str)
+{
+    ft::Regex::MatchIterator    it(r, str.data(), str.size());
+    std::ostringstream          out;
+
+    while (it.next())
+    {
+        if (!out.str().empty())
+            out << ' ';
+        out << it.result().position() << ',' << it.result().length();
+    }
+    return out.str();
+}
+
+// the iterator of each engine, without the DFAs too, and matchAll() find
+// the expected matches
+bool    expect_all(const char *regex, const char *str, const char *expected)
+{
+    ft::Regex                           r(regex);
+    ft::Regex                           noDFA(regex);
+    std::vector<ft::Regex::result_t>    results = r.matchAll(str);
+    std::string                         byDefault = all_spans(r, str);
+    std::string                         wrong;
+
+    noDFA.setDFABudget(0);
+    if (all_spans(ft::Regex(regex, ft::Regex::pikeVM), str) != byDefault)
+        wrong += " pikeVM";
+    if (all_spans(noDFA, str) != byDefault)
+        wrong += " setDFABudget(0)";
+    ft::Regex::MatchIterator    it(r, str, std::strlen(str));
+    for (size_t i = 0; i <= results.size(); i++)
+        if (it.next() != (i < results.size())
+            || (i < results.size() && it.result().str() != results[i].str))
+        {
+            wrong += " matchAll()";
+            break;
+        }
+    std::cout << "All: " << regex << " on \"" << str << "\" | " << byDefault;
+    if (!wrong.empty())
+        std::cout << " | wrong:" << wrong;
+    if (byDefault != expected)
+        std::cout << " | expected: " << expected;
+    std::cout << std::endl;
+    return wrong.empty() && byDefault == expected;
+}
+
+// a match_t reused by other regexes and inputs holds the groups of its
+// last match only, and matching again does not take another buffer
+bool    reuse_match()
+{
+    ft::Regex           three("(\\w+)-(\\w+)-(\\w+)");
+    ft::Regex           one("(\\d+)");
+    ft::Regex           unset("(a)|b");
+    ft::Regex::match_t  m;
+    const char * const  *buffer;
+    std::string         wrong;
+
+    if (!three.match("ab-cd-ef", 8, m) || m.groups() != 4 || m.str(3) != "ef")
+        wrong += " three";
+    buffer = &m.slots[0];
+    if (!one.match("x 42", 4, m) || m.groups() != 2 || m.position(1) != 2 || m.str(1) != "42")
+        wrong += " one";
+    if (!three.match("1-2-3 ", 6, m) || m.groups() != 4 || m.str(2) != "2"
+        || m.position(3) != 4)
+        wrong += " three again";
+    if (&m.slots[0] != buffer)
+        wrong += " buffer";
+    if (!unset.match("xb", 2, m) || m.groups() != 2 || m.position(1) != 1
+        || m.length(1) != 0)
+        wrong += " unset";
+    std::cout << "Reused match_t";
+    if (!wrong.empty())
+        std::cout << " | wrong:" << wrong;
+    std::cout << std::endl;
+    return wrong.empty();
+}
+
+// the backtracker gives the same match and groups whether it remembers
+// the states that failed, forgets them for lack of memory or does not
+// remember them at all; the DFA is left out so it tries every start
+bool    expect_memo(const char *regex, const char *str, const char *expected)
+{
+    size_t      limits[] = { 0, 8 };
+    ft::Regex   r(regex);
+    std::string wrong;
+
+    r.setDFABudget(0);
+    if (spans(r, str) != expected)
+        wrong += " memo";
+    for (size_t i = 0; i < sizeof(limits) / sizeof(*limits); i++)
+    {
+        std::ostringstream  limit;
+        r.setMemoLimit(limits[i]);
+        limit << " setMemoLimit(" << limits[i] << ')';
+        if (spans(r, str) != expected)
+            wrong += limit.str();
+    }
+    std::cout << "Memo: " << regex << " on \"" << str << "\" | " << expected;
+    if (!wrong.empty())
+        std::cout << " | wrong:" << wrong;
+    std::cout << std::endl;
+    return wrong.empty();
+}
+
+// the ids a set reports on each input are the expected ones and the
+// patterns whose own test() matches, with the DFA of the set flushed or
+// giving up too
+bool    compare_set()
+{
+    const char  *patterns[] = { "cat", "^dog", "bird$", "\\bow\\b", "(\\w)\\1",
+        "a(?=b)", "(?:\\ba*){2}b", "[0-9]{3}-[0-9]{4}", "x*", "c.t|d[aeiou]g",
+        "(a|b)*?c$" };
+    const char  *inputs[] = { "", "cat", "a dog\nbird", "dog ow", "owl bow", "abba",
+        "aab", "call 555-0199", "cut", "ab\nc", "\nDOG" };
+    const char  *hits[] = { "", "0 8 9", "2 6 8 9 11", "1 3 8 9 11", "6 8", "4 5 8",
+        "4 5 8", "4 7 8", "8 9", "5 8 10", "8 11" };
+    size_t      count = sizeof(patterns) / sizeof(*patterns);
+    size_t      budgets[] = { ft::RegexSet::DefaultBudget, 2048, 1 };
+    ft::RegexSet            set;
+    std::vector<size_t>     ids;
+    std::ostringstream      wrong;
+
+    for (size_t i = 0; i < count; i++)
+        set.add(patterns[i]);
+    set.add("dog", ft::Regex::iCase);
+    set.compile();
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(*budgets); b++)
+    {
+        set.setDFABudget(budgets[b]);
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(*inputs); i++)
+        {
+            std::vector<size_t> expected;
+            std::ostringstream  reported;
+
+            for (size_t id = 0; id < set.size(); id++)
+                if (set[id].test(inputs[i]))
+                    expected.push_back(id);
+            if (set.test(inputs[i], ids) != !expected.empty() || ids != expected)
+                wrong << " \"" << inputs[i] << "\" (budget " << budgets[b] << ')';
+            for (size_t id = 0; id < ids.size(); id++)
+                reported << (id ? " " : "") << ids[id];
+            if (reported.str() != hits[i])
+                wrong << " \"" << inputs[i] << "\" gives " << reported.str();
+        }
+    }
+    std::cout << "Set: " << set.size() << " patterns";
+    if (!wrong.str().empty())
+        std::cout << " | wrong:" << wrong.str();
+    std::cout << std::endl;
+    return wrong.str().empty();
+}
+
+// a tree spread over many blocks of its arena matches like a small one,
+// a parse error after many components throws, and memoryUsage() grows
+// with the pattern and is the same for two builds of it
+bool    arena_patterns()
+{
+    std::ostringstream  words;
+    std::string         wrong;
+
+    words << "\\b(?:";
+    for (int i = 0; i < 2000; i++)
+        words << (i ? "|" : "") << 'w' << i << "[a-z0-9]?";
+    words << ")\\b";
+    ft::Regex   large(words.str());
+    ft::Regex   again(words.str());
+    ft::Regex   small("w1");
+
+    if (spans(large, "xx w1234 w5") != "3,5" || spans(large, "w20000") != "no match")
+        wrong += " match";
+    if (large.memoryUsage() != again.memoryUsage()
+        || large.memoryUsage() <= small.memoryUsage()
+        || small.memoryUsage() < sizeof(ft::Regex))
+        wrong += " memoryUsage()";
+    try
+    {
+        ft::Regex   unbalanced(words.str() + "(a|b");
+        wrong += " no error";
+    }
+    catch (ft::Regex::InvalidRegexException const&)
+    {
+    }
+    std::cout << "Arena: " << large.memoryUsage() << " bytes for 2000 alternatives, "
+        << small.memoryUsage() << " for one";
+    if (!wrong.empty())
+        std::cout << " | wrong:" << wrong;
+    std::cout << std::endl;
+    return wrong.empty();
+}
+
+// the match and groups of the program of a regex, back-references and
+// counted loops included
+bool    expect_program(const char *regex, std::string const& str, const char *expected,
+    unsigned int flags = 0)
+{
+    std::string byDefault = spans(ft::Regex(regex, flags), str);
+
+    std::cout << "Program: " << regex << " on " << str.size() << " bytes | " << byDefault;
+    if (byDefault != expected)
+        std::cout << " | expected: " << expected;
+    std::cout << std::endl;
+    return byDefault == expected;
+}
+
+// a pattern of regex_redos on an input it would take exponential time on:
+// without the DFA, the backtracker and its memo give the same match as
+// the Pike VM, without its memo either it finishes or is aborted
+bool    expect_redos(const char *regex, std::string const& input, const char *expected)
+{
+    ft::Regex           r(regex);
+    ft::Regex           noDFA(regex);
+    ft::Regex           noMemo(regex);
+    ft::Regex::match_t  m;
+    ft::Regex::limit_t  limit;
+    std::string         wrong;
+    int                 res;
+
+    noDFA.setDFABudget(0);
+    noMemo.setDFABudget(0);
+    noMemo.setMemoLimit(0);
+    if (spans(r, input) != expected)
+        wrong += " default";
+    if (spans(noDFA, input) != expected)
+        wrong += " setDFABudget(0)";
+    if (spans(ft::Regex(regex, ft::Regex::pikeVM), input) != expected)
+        wrong += " pikeVM";
+    limit.timeout(100);
+    res = noMemo.tryMatch(input.data(), input.size(), m, limit);
+    if (res != ft::Regex::Aborted && (res == ft::Regex::Match) != (std::string(expected) != "no match"))
+        wrong += " setMemoLimit(0)";
+    std::cout << "ReDoS: " << regex << " on " << input.size() << " bytes | " << expected;
+    if (!wrong.empty())
+        std::cout << " | wrong:" << wrong;
+    std::cout << std::endl;
+    return wrong.empty();
 }
 
 void    benchmark(const char *regex, const char *str, int times = 100)
@@ -40,10 +502,11 @@ void    benchmark(const char *regex, const char *str, int times = 100)
         ft::Regex r(regex);
         end = clock();
         compiling += (double)(end - start) * 1000 / CLOCKS_PER_SEC;
+        ft::Regex::result_t res;
         start = clock();
-        r.match(str);
+        r.match(str, res);
         end = clock();
-        matching += (double)(end - start)* 100 / CLOCKS_PER_SEC;
+        matching += (double)(end - start) * 1000 / CLOCKS_PER_SEC;
     }
     std::cout << "Compiling: " << compiling / times << "ms | ";
     std::cout << "Matching: " << matching / times << "ms | ";
@@ -51,10 +514,398 @@ void    benchmark(const char *regex, const char *str, int times = 100)
     // std::cout << std::endl;
 }
 
+struct  thread_job
+{
+    ft::Regex const *regex;
+    const char      *str;
+    int             times;
+};
+
+void    *match_loop(void *arg)
+{
+    thread_job  *job = static_cast<thread_job *>(arg);
+
+    for (int i = 0; i < job->times; i++)
+    {
+        ft::Regex::result_t res;
+        job->regex->match(job->str, res);
+    }
+    return NULL;
+}
+
+// one Regex shared by every thread, each thread runs `times` matches
+void    benchmark_threads(const char *regex, const char *str, int times = 20000)
+{
+    ft::Regex   r(regex);
+    thread_job  job = {&r, str, times};
+    pthread_t   threads[8];
+    timeval     start, end;
+
+    for (int n = 1; n <= 8; n *= 2)
+    {
+        gettimeofday(&start, NULL);
+        for (int i = 0; i < n; i++)
+            pthread_create(&threads[i], NULL, match_loop, &job);
+        for (int i = 0; i < n; i++)
+            pthread_join(threads[i], NULL);
+        gettimeofday(&end, NULL);
+        double elapsed = (end.tv_sec - start.tv_sec) * 1000.0
+            + (end.tv_usec - start.tv_usec) / 1000.0;
+        std::cout << n << " threads: " << elapsed << "ms | "
+            << n * times / elapsed << " matches/ms" << std::endl;
+    }
+}
+
+// a regex built from the same pattern on every request: compiled once,
+// then found in the cache
+void    benchmark_cache(const char *regex, const char *str, int times = 1000)
+{
+    ft::RegexCache  cache;
+    struct timeval  start, end;
+
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < times; i++)
+        cache.get(regex)->test(str);
+    gettimeofday(&end, NULL);
+    std::cout << "Cached: " << ((end.tv_sec - start.tv_sec) * 1000.0
+        + (end.tv_usec - start.tv_usec) / 1000.0) / times << "ms | ";
+    std::cout << cache.hits() << " hits, " << cache.misses() << " misses" << std::endl;
+}
+
+static double  elapsed(struct timeval const& start)
+{
+    struct timeval  end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+}
+
+// a thread going through many regexes in turn: each keeps the engines it
+// built in the first round, the next rounds do not build them again
+bool    rotate_regexes(int count, int rounds = 3)
+{
+    std::vector<ft::Regex *>    regexes;
+    ft::Regex::match_t          m;
+    std::string                 text = "a " + std::string(count, 'w');
+    struct timeval              start;
+    int                         wrong = 0;
+    double                      first = 0, next = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        std::ostringstream  pattern;
+        pattern << "(\\w+)\\s(\\w{" << i + 1 << "})";
+        regexes.push_back(new ft::Regex(pattern.str()));
+    }
+    for (int round = 0; round < rounds; round++)
+    {
+        gettimeofday(&start, NULL);
+        for (int i = 0; i < count; i++)
+            if (!regexes[i]->match(text.data(), text.size(), m)
+                || m.length(2) != static_cast<size_t>(i + 1))
+                wrong++;
+        (round ? next : first) += elapsed(start);
+    }
+    for (int i = 0; i < count; i++)
+        delete regexes[i];
+    std::cout << "Rotation: " << count << " regexes | first round "
+        << first * 1000 / count << "us/match | next rounds "
+        << next * 1000 / count / (rounds - 1) << "us/match | "
+        << wrong << " wrong" << std::endl;
+    return !wrong && 2 * next / (rounds - 1) < first;
+}
+
+// starting with the patterns compiled from their source or loaded from an image
+void    benchmark_image(int patterns, const char *str)
+{
+    const char      *path = "benchmark.img";
+    struct timeval  start;
+    ft::RegexSet    set;
+    std::vector<size_t> compiled, loaded;
+
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < patterns; i++)
+    {
+        std::ostringstream  pattern;
+        pattern << "(\\w+)@host" << i << "\\.(com|org)|id=" << i << "[a-f0-9]{8}";
+        set.add(pattern.str());
+    }
+    set.compile();
+    double  compiling = elapsed(start);
+    ft::RegexImage::write(path, set);
+
+    gettimeofday(&start, NULL);
+    ft::RegexImage  image(path);
+    double  loading = elapsed(start);
+
+    set.test(str, compiled);
+    image.set()->test(str, loaded);
+    std::cout << "Startup (" << patterns << " patterns): compiling " << compiling
+        << "ms | loading the image " << loading << "ms | "
+        << compiled.size() << " / " << loaded.size() << " hits" << std::endl;
+    std::remove(path);
+}
+
+// a long input fed in network-sized chunks, nothing is buffered
+void    benchmark_stream(const char *regex, const char *str, size_t chunk = 1500,
+    int times = 200000)
+{
+    ft::Regex       r(regex);
+    ft::RegexStream stream(r);
+    std::string     text;
+    std::vector<ft::RegexStream::offset_t>  ends;
+    size_t          matches = 0;
+    struct timeval  start;
+
+    for (int i = 0; i < times; i++)
+        text += str;
+    gettimeofday(&start, NULL);
+    for (size_t pos = 0; pos < text.size(); pos += chunk)
+    {
+        stream.feed(text.data() + pos, std::min(chunk, text.size() - pos), ends);
+        matches += ends.size();
+    }
+    stream.finish(ends);
+    matches += ends.size();
+    double  ms = elapsed(start);
+    std::cout << "Stream: " << text.size() / chunk + 1 << " chunks of " << chunk
+        << " bytes | " << ms << "ms | " << text.size() / 1000.0 / ms << " MB/s | "
+        << matches << " match ends" << std::endl;
+}
+
+// rows/s of test() on every row against filter() of the whole column,
+// the rows being the words of the sample one after the other
+void    benchmark_filter(const char *regex, const char *str, size_t threads = 4,
+    int times = 100000)
+{
+    ft::Regex                   r(regex);
+    std::istringstream          words(str);
+    std::vector<std::string>    sample;
+    std::string                 data;
+    std::vector<int>            offsets(1, 0);
+    std::vector<unsigned char>  mask;
+    std::string                 word;
+    struct timeval              start;
+
+    while (words >> word)
+        sample.push_back(word);
+    for (int i = 0; i < times; i++)
+    {
+        data += sample[i % sample.size()];
+        offsets.push_back(data.size());
+    }
+    ft::Regex::column_t column(data.data(), &offsets[0], times);
 
+    size_t  matches = 0;
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < times; i++)
+        matches += r.test(column.begin(i), column.end(i) - column.begin(i));
+    double  ms = elapsed(start);
+    std::cout << "Filter: " << times << " rows | test() " << ms << "ms | "
+        << times / ms / 1000.0 << " Mrows/s | " << matches << " matches" << std::endl;
+    for (size_t t = 1; ; t = threads)
+    {
+        gettimeofday(&start, NULL);
+        matches = r.filter(column, mask, t);
+        ms = elapsed(start);
+        std::cout << "Filter: " << times << " rows | filter() " << t << " threads "
+            << ms << "ms | " << times / ms / 1000.0 << " Mrows/s | " << matches
+            << " matches" << std::endl;
+        if (t == threads)
+            break;
+    }
+}
+
+// where a match spends its steps, component by component
+void    profile(const char *regex, const char *str)
+{
+    ft::Regex               r(regex);
+    ft::Regex::profile_t    p;
+
+    r.profile(str, std::strlen(str), p);
+    std::cout << "Profile: " << regex << " on \"" << str << '"' << std::endl;
+    p.dump(std::cout);
+}
 
 int main()
 {
+    int failures = 0;
+
+    // loops whose body can match the empty string
+    failures += !compare_engines("(x|a?\?)*", "xa");
+    failures += !compare_engines("(?:\\w??|\\s)*[ab]", " ba");
+    failures += !compare_engines("(.?)+", "ab");
+    failures += !compare_engines("((a?)*b?)*c", "aabbac");
+    failures += !compare_engines("(a?(\\s)|(\\w*?b?\?)*a*)+", "a a");
+    failures += !compare_engines("((x{0,2}){1,2}?[ab]?)+", "xaab");
+    failures += !compare_engines("(\\w+)\\s(\\w+)\\s(\\w+)", "Hello\tWorld Again");
+    // counted repeats leave after an empty iteration
+    failures += !expect_spans("(b{0,2}?){0,2}c", "bbc", "0,3 1,1");
+    failures += !expect_spans("(a|b?\?){1,2}c", "bc", "0,2 1,0");
+    // the DFA cannot tell which of these iterations were empty
+    failures += !expect_spans("(?:\\ba*){2}b", "aab", "no match");
+    failures += !expect_spans("(?:\\ba*){2}b|c", "aab c", "4,1");
+    failures += !expect_spans("((?:(\\s|.){1,3})*^($|\\w)){2}", "a a a\nB ", "0,7 1,6 5,1 6,1");
+    // lazy repeats only leave their loop after an empty iteration
+    failures += !expect_spans("(?:\\bb?){2,}?", "bb", "0,1");
+    failures += !expect_spans("((?:(?:\\b[ab]?)a?)){2}?", "aaba", "0,2 0,2");
+    failures += !expect_spans("(a?){2}?b", "ab", "0,2 1,0");
+    failures += !expect_spans("(a?){2,}?b", "aab", "0,3 1,1");
+    // the look-arounds reuse their sub-run, nested ones the sub-run of it
+    failures += !expect_spans("(?<=a(?=b)b)c", "abbc xabc", "8,1");
+    failures += !expect_spans("(?=[ab](c))\\w\\w\\s", "abbbbc ", "4,3 5,1");
+    failures += !expect_spans("(?<!x)(?=(b))\\w\\s", "xb ab ", "4,2 4,1");
+    failures += !expect_spans("(?=(a))(?!\\w(?<=b))\\w(?<=(a)|c)", "ba ca ab a", "1,1 1,1 1,1");
+    // 32 DFA states for the a 5 bytes before the c, the text of a and b
+    // flushes a small cache many times over
+    {
+        std::string         text;
+        std::ostringstream  expected;
+        unsigned int        seed = 1;
+
+        for (int i = 0; i < 4000; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            text += (seed >> 16) & 1 ? 'a' : 'b';
+        }
+        expected << "0," << text.size() + 6 << ' ' << text.size() - 1 << ",1 "
+            << text.size() + 4 << ",1";
+        failures += !expect_dfa_budgets("([ab])*a([ab]){4}c", text + "aabbac", expected.str());
+        failures += !expect_dfa_budgets("([ab])*a([ab]){4}c", text + "abbbbbc", "no match");
+    }
+    // ^ is only tried at line starts, $ patterns are searched backwards
+    failures += !expect_spans("^ab\\d", "ab ab1\nxab2\nab3", "12,3");
+    failures += !expect_spans("^(\\w)|c$", "-ab\n\n-c\nd", "6,1 6,0");
+    failures += !expect_spans("(\\d+)$", "12 34\n56 78", "3,2 3,2");
+    failures += !expect_spans("\\w+$", "ab cd\nef", "3,2");
+    failures += !expect_spans("a$|b", "ab\n", "1,1");
+    {
+        std::string text;
+
+        for (int i = 0; i < 300; i++)
+            text += "abc. x\n";
+        failures += !expect_dfa_budgets("([a-c]+)\\.$", text + "zz cab.", "2103,4 2103,3");
+        failures += !expect_dfa_budgets("([a-c]+)\\.$", text + "zz cab. ", "no match");
+    }
+    // NULs are bytes like the others, the bytes after the length are not read
+    failures += !expect_data("a.b", std::string("a\0b", 3), "0,3");
+    failures += !expect_data("[^x]+", std::string("ab\0cd", 5), "0,5");
+    failures += !expect_data(std::string("a\0+b", 4), std::string("xa\0\0b", 5), "1,4");
+    failures += !expect_data("c", std::string("ab\0c", 4), "3,1");
+    failures += !expect_data("\\w+$", std::string("ab\0cd", 5), "3,2");
+    failures += !expect_data("b\\b", std::string("ab\0", 3), "1,1");
+    {
+        ft::Regex           c("c");
+        ft::Regex::match_t  m;
+
+        if (c.test("abc", 2) || c.match("abc", 2, m) || !c.test("abc", 3))
+        {
+            std::cout << "Data: c found past the length of \"abc\"" << std::endl;
+            failures++;
+        }
+    }
+    // the next search starts at the end of a match, after an empty one,
+    // and sees the bytes before it
+    failures += !expect_all("a*", "baaac", "0,0 1,3 4,0");
+    failures += !expect_all("x?", "ab", "0,0 1,0");
+    failures += !expect_all("\\B", "abc", "1,0 2,0");
+    failures += !expect_all("a|ab", "abab", "0,1 2,1");
+    failures += !expect_all("\\b\\w", "ab cd", "0,1 3,1");
+    failures += !expect_all("^\\w", "ab\ncd\n\nef", "0,1 3,1 7,1");
+    failures += !expect_all("(?<=a)b", "abab", "1,1 3,1");
+    failures += !expect_all("\\d+$", "1\n22\n333", "0,1 2,2 5,3");
+    failures += !expect_all("(\\w)\\1", "aabbcdd", "0,2 2,2 5,2");
+    {
+        ft::Regex                   r("\\w+");
+        const char                  *str = "ab cd\nef gh";
+        ft::Regex::MatchIterator    it(r, str, std::strlen(str));
+        bool                        right = it.next();
+
+        // a line after the one that matched
+        it.seek(std::strchr(str, '\n') + 1);
+        right = right && it.next() && it.result().position() == 6
+            && it.next() && it.result().str() == "gh" && !it.next();
+        if (!right)
+        {
+            std::cout << "All: seek() to the next line of \"" << str << "\" is wrong" << std::endl;
+            failures++;
+        }
+    }
+    failures += !reuse_match();
+    // the failed states are tried once, the captures do not change
+    failures += !expect_memo("(a|ab)(c|bcd)(d*)", "abcd", "0,4 0,1 1,3 4,0");
+    failures += !expect_memo("((a|b)*?b)+c", "ababbc", "0,6 4,1 2,1");
+    failures += !expect_memo("(\\w+\\s?)*$", "ab cd ef!", "no match");
+    failures += !expect_memo("(a*)*b|(c)", "aaaaaaaaaaaaaaaaaaaac", "20,1 20,0 20,1");
+    failures += !expect_memo("(x+x+)+y", "xxxxxxxxxxxxxxxxxxxxxy", "0,22 0,21");
+    failures += !expect_memo("(a?)*?b|(a?)+c", "aac", "0,3 0,0 2,0");
+    failures += !expect_memo("(?:(a)|b\\b)*c", "abab c", "5,1 5,0");
+    // a state inside a loop whose iteration started at the position is
+    // not the same one, the loop is left from it
+    failures += !expect_memo("((a?)*b?)*c", "aabbac", "0,6 5,0 5,0");
+    failures += !expect_memo("(a?(\\s)|(\\w*?b?\?)*a*)+", "a a", "0,3 3,0 1,1 3,0");
+    failures += !compare_set();
+    failures += !arena_patterns();
+    // each kind of instruction of the program
+    failures += !expect_program("(a+)b\\1", "aaabaa", "1,5 1,2");
+    failures += !expect_program("<(.+?)>", "<a><b>", "0,3 1,1");
+    failures += !expect_program("(ab){2,3}", "abababab", "0,6 4,2");
+    failures += !expect_program("a{0}b", "ab", "1,1");
+    failures += !expect_program("[^a-c\\d]+", "ab1xyz", "3,3");
+    failures += !expect_program("(a)|b", "b", "0,1 0,0");
+    failures += !expect_program("x(?!y)\\w", "xyxz", "2,2");
+    failures += !expect_program("(?<=\\d\\d)px", "1px 12px", "6,2");
+    failures += !expect_program("^$", "a\n\nb", "2,0");
+    failures += !expect_program("hel+o", "say HeLLo", "4,5", ft::Regex::iCase);
+    // too many copies of the body, the repeat loops on a counter
+    failures += !expect_program("(?:(?:a|bc){1000}){100}", std::string(99999, 'a') + "bc",
+        "0,100001");
+    failures += !expect_program("(?:(?:a|bc){1000}){100}", std::string(2000, 'a') + "b",
+        "no match");
+    // the inputs of regex_redos, with and without the end they miss
+    {
+        std::string a(2000, 'a');
+        std::string x(2000, 'x');
+
+        failures += !expect_redos("^(a+)+$", a + "!", "no match");
+        failures += !expect_redos("^(a+)+$", a, "0,2000 0,2000");
+        failures += !expect_redos("(a|aa)*c\\b", "ca" + a, "no match");
+        failures += !expect_redos("(a|aa)*c\\b", "ca" + a + "c", "1,2002 2001,1");
+        failures += !expect_redos("(x+x+)+y", x, "no match");
+        failures += !expect_redos("(x+x+)+y", x + "y", "0,2001 0,2000");
+        failures += !expect_redos(".*.*=.*;", ";=" + x, "no match");
+        failures += !expect_redos(".*.*=.*;", ";=" + x + ";", "0,2003");
+        // too many states for the memo past a few hundred bytes, see regex_redos
+        failures += !expect_redos("a{1,1024}a{1,1024}b", a.substr(0, 200), "no match");
+        failures += !expect_redos("a{1,1024}a{1,1024}b", a.substr(0, 200) + "b", "0,201");
+    }
+    // literal prefixes found by memchr and memmem
+    failures += !expect_at_offsets("x\\d+", std::string("\0x-a\0\nxx", 8), "x42");
+    failures += !expect_at_offsets("needle\\w", std::string("\0need needl\0e nee", 18), "needleZ");
+    // required literals, missing from the text or only near misses of them
+    failures += !expect_at_offsets("=\\w+@host\\.com", std::string("=x@hos\0@host.co\n", 16),
+        "=ab@host.com");
+    failures += !expect_at_offsets("\\d+kg", std::string("k\0g k-gx ", 9), "7kg");
+    // the first bytes scanned a vector at a time as up to four ranges, or
+    // one at a time; bytes above 0x7f must not be taken for negative ones.
+    // Without other first bytes in the text, the scan reaches the needle
+    // in each lane of its vectors
+    failures += !expect_at_offsets("[q-s]\\d", std::string("\0p\xf1t\x7f-\n", 7), "r7");
+    failures += !expect_at_offsets("[q-s]\\d", std::string("\0p\xf1t\x7f" "q-r s\n", 11), "r7");
+    failures += !expect_at_offsets("(?:\\d|[A-F])[:x]", std::string("9-\0A F\xc3G:x", 10), "B:");
+    failures += !expect_at_offsets("[\xe0-\xef]\\d", std::string("\xdf\xf0\0\xe5-\x80", 6),
+        "\xe9" "5");
+    failures += !expect_at_offsets("[aeiou]\\d", std::string("a-e\0i o\xe9u\n", 11), "o3");
+    // the SPLITs taken and the backtracks to their other branch are the steps
+    failures += !expect_steps("a|(b)\\1", "a", 1);
+    failures += !expect_steps("x|(a)\\1", "aa", 2);
+    failures += !expect_steps("(a*)\\1b", "aab", 5);
+    failures += !expect_steps("x|(a)\\1", "ab", 2, ft::Regex::NoMatch);
+    failures += !expect_steps("(a|b)\\1", "abc", 4, ft::Regex::NoMatch);
+    failures += !expect_deadline("(x*)\\1(?:a|a)*(?!a)\\W", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+    // more regexes than a thread used to keep the engines of
+    failures += !rotate_regexes(100);
+
     benchmark("(\\w+)\\s(\\w+)\\s(\\w+)", "Hello\tWorld Again");
     
     benchmark("\\b(?:(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?)\\.){3}(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?)\\b", "this is my not and ip: 192.168.1.999 but this an  ip: 192.168.1.1");
@@ -97,5 +948,17 @@ int main()
     benchmark("\\b(?:4[0-9]{12}(?:[0-9]{3})?|5[1-5][0-9]{14}|6(?:011|5[0-9][0-9])[0-9]{12}|3[47][0-9]{13}|3(?:0[0-5]|[68][0-9])[0-9]{11}|(?:2131|1800|35\\d{3})\\d{11})\\b", "f you're looking for random paragraphs, you've come to the right place. When a random word or a random sentence isn't quite enough, the 4650398256543094 next logical step is to find a random paragraph. We created the Random Paragraph Generator with you in mind. The process is quite simple. Choose the number of random paragraphs you'd like to see and click the button. Your chosen number of paragraphs will instantly appear.");
     benchmark("\\b(?:4[0-9]{12}(?:[0-9]{3})?|5[1-5][0-9]{14}|6(?:011|5[0-9][0-9])[0-9]{12}|3[47][0-9]{13}|3(?:0[0-5]|[68][0-9])[0-9]{11}|(?:2131|1800|35\\d{3})\\d{11})\\b", "01234567896352");
 
-    return 0;
-}
\ No newline at end of file
+    benchmark_cache("(([0-9a-fA-F]{1,4}:){7,7}[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,7}:|([0-9a-fA-F]{1,4}:){1,6}:[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,5}(:[0-9a-fA-F]{1,4}){1,2}|([0-9a-fA-F]{1,4}:){1,4}(:[0-9a-fA-F]{1,4}){1,3}|([0-9a-fA-F]{1,4}:){1,3}(:[0-9a-fA-F]{1,4}){1,4}|([0-9a-fA-F]{1,4}:){1,2}(:[0-9a-fA-F]{1,4}){1,5}|[0-9a-fA-F]{1,4}:((:[0-9a-fA-F]{1,4}){1,6})|:((:[0-9a-fA-F]{1,4}){1,7}|:)|fe80:(:[0-9a-fA-F]{0,4}){0,4}%[0-9a-zA-Z]{1,}|::(ffff(:0{1,4}){0,1}:){0,1}((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])|([0-9a-fA-F]{1,4}:){1,4}:((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9]))", "2001:db8:3333:4444:5555:6666:7777:8888");
+
+    benchmark_stream("\\b(\\w+)@(\\w+)\\.com\\b", "some text around john@example.com and more text. ");
+
+    benchmark_filter("^[a-z]+@\\w+\\.(com|org)$", "ana@host.com bob@mail.org not-an-address eve@x.net carol@site.com 42");
+
+    profile("^(a+)+$", "aaaaaaaaaaaa!");
+
+    benchmark_image(5000, "mail me at john@host4242.org, id=17deadbeef");
+
+    benchmark_threads("(\\w+)\\s(\\w+)\\s(\\w+)", "Hello\tWorld Again");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,305 @@
+#include <Regex.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <time.h>
+#include <unistd.h>
+
+// regex_redos [-m bytes] [-t ms] [-o data] [filter]
+// Runs patterns known to make backtracking matchers take exponential or
+// polynomial time on inputs growing tenfold from 1KB to 100MB, with each
+// engine on its own:
+//     dfa         test(), the lazy DFA
+//     backtrack   match() with the DFA disabled, the failed states memo on
+//     nomemo      the same without the memo
+//     pike        match() with the Pike VM, the DFA disabled
+// The growth column is the exponent of the time against the input length
+// between the two largest inputs run in time, 1 for linear time. A run
+// over -t ms is aborted (the backtracking engines) and ends the series,
+// so does a size predicted to take that long (the only limit of the
+// engines that cannot be stopped).
+// -o writes every point as tab separated `case engine bytes ns status`
+// lines, to be plotted
+
+static const double     MinNs = 20000000;       // repeats of a small input
+static const size_t     MinRuns = 3;
+
+struct case_t
+{
+    const char      *name;
+    const char      *pattern;
+    const char      *head;      // the input is head, unit repeated then tail
+    const char      *unit;
+    const char      *tail;
+    bool            random;     // unit bytes in random order
+    bool            backrefs;   // the backtracker alone runs it
+};
+
+// None of the inputs matches. Each but nested holds the literal its
+// pattern requires so that it is not rejected before any engine runs;
+// nested shows that check: no input without a match holds "ab"
+static const case_t     cases[] = {
+    { "nested", "(a+)+b", "b", "a", "", false, false },
+    { "anchored", "^(a+)+$", "", "a", "!", false, false },
+    { "alternation", "(a|aa)*c\\b", "ca", "a", "", false, false },
+    { "overlap", "(x+x+)+y", "y", "x", "", false, false },
+    { "dotstar", ".*.*=.*;", ";=", "x", "", false, false },
+    { "counted", "a{1,1024}a{1,1024}b", "b", "a", "", false, false },
+    { "dfa-states", "[ab]*a[ab]{20}c", "c", "ab", "", true, false },
+    { "ipv6", "(([0-9a-fA-F]{1,4}:){7,7}[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,7}:|([0-9a-fA-F]{1,4}:){1,6}:[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,5}(:[0-9a-fA-F]{1,4}){1,2}|([0-9a-fA-F]{1,4}:){1,4}(:[0-9a-fA-F]{1,4}){1,3}|([0-9a-fA-F]{1,4}:){1,3}(:[0-9a-fA-F]{1,4}){1,4}|([0-9a-fA-F]{1,4}:){1,2}(:[0-9a-fA-F]{1,4}){1,5}|[0-9a-fA-F]{1,4}:((:[0-9a-fA-F]{1,4}){1,6})|:((:[0-9a-fA-F]{1,4}){1,7}|:)|fe80:(:[0-9a-fA-F]{0,4}){0,4}%[0-9a-zA-Z]{1,}|::(ffff(:0{1,4}){0,1}:){0,1}((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])|([0-9a-fA-F]{1,4}:){1,4}:((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9]))",
+        "", "abcd:abcd:abcd:abcd:abcd:abcd:g ", "", false, false },
+    { "date", "(?:(?:31(\\/|-|\\.)(?:0?[13578]|1[02]))\\1|(?:(?:29|30)(\\/|-|\\.)(?:0?[1,3-9]|1[0-2])\\2))(?:(?:1[6-9]|[2-9]\\d)?\\d{2})$|^(?:29(\\/|-|\\.)0?2\\3(?:(?:(?:1[6-9]|[2-9]\\d)?(?:0[48]|[2468][048]|[13579][26])|(?:(?:16|[2468][048]|[3579][26])00))))$|^(?:0?[1-9]|1\\d|2[0-8])(\\/|-|\\.)(?:(?:0?[1-9])|(?:1[0-2]))\\4(?:(?:1[6-9]|[2-9]\\d)?\\d{2})",
+        "", "31/12/", "", false, true },
+};
+
+enum
+{
+    DFA,
+    Backtrack,
+    NoMemo,
+    Pike,
+    Engines,
+};
+
+static const char   *engines[] = { "dfa", "backtrack", "nomemo", "pike" };
+
+enum
+{
+    Done,
+    Aborted,        // over the time limit
+    Skipped,        // predicted over the time limit
+    Unsupported,    // the engine does not run the pattern
+    Matched,        // the input was expected not to match
+};
+
+static const char   *statuses[] = { "ok", "aborted", "skipped", "-", "matched" };
+
+struct point_t
+{
+    size_t      bytes;
+    double      ns;
+    int         status;
+};
+
+static double   now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static std::string  makeInput(case_t const& c, size_t bytes)
+{
+    std::string input(c.head);
+    size_t      unit = std::strlen(c.unit);
+    size_t      body = bytes - std::strlen(c.tail);
+
+    input.reserve(bytes);
+    srand(42);
+    for (size_t i = 0; input.size() < body; i++)
+        input += c.unit[c.random ? rand() % unit : i % unit];
+    return input + c.tail;
+}
+
+// the fastest of the runs, at least MinRuns of them and MinNs in all
+static point_t  run(ft::Regex const& r, int engine, std::string const& input, double timeout)
+{
+    point_t             p = { input.size(), 0, Done };
+    ft::Regex::match_t  m;
+    double              total = 0;
+
+    for (size_t runs = 0; runs < MinRuns || total < MinNs; runs++)
+    {
+        ft::Regex::limit_t  limit;
+        limit.timeout(timeout / 1e6);
+        double              start = now();
+        int                 res;
+
+        if (engine == DFA)
+            res = r.test(input) ? ft::Regex::Match : ft::Regex::NoMatch;
+        else
+            res = r.tryMatch(input.data(), input.size(), m, limit);
+        double  ns = now() - start;
+
+        if (res != ft::Regex::NoMatch)
+        {
+            p.status = res == ft::Regex::Aborted ? Aborted : Matched;
+            p.ns = ns;
+            return p;
+        }
+        p.ns = runs ? std::min(p.ns, ns) : ns;
+        total += ns;
+        if (ns * MinRuns > MinNs)
+            break;
+    }
+    return p;
+}
+
+static bool     supports(case_t const& c, int engine)
+{
+    return !c.backrefs || engine == Backtrack;
+}
+
+static ft::Regex    *compile(case_t const& c, int engine)
+{
+    ft::Regex   *r = new ft::Regex(c.pattern, engine == Pike ? ft::Regex::pikeVM : 0);
+
+    // without the DFA match() runs the engine alone
+    if (engine != DFA)
+        r->setDFABudget(0);
+    if (engine == NoMemo)
+        r->setMemoLimit(0);
+    return r;
+}
+
+static std::string  format(point_t const& p)
+{
+    char    buf[32];
+
+    if (p.status == Skipped || p.status == Unsupported)
+        return statuses[p.status];
+    if (p.ns < 1e3)
+        std::snprintf(buf, sizeof(buf), "%.0fns", p.ns);
+    else if (p.ns < 1e6)
+        std::snprintf(buf, sizeof(buf), "%.1fus", p.ns / 1e3);
+    else if (p.ns < 1e9)
+        std::snprintf(buf, sizeof(buf), "%.1fms", p.ns / 1e6);
+    else
+        std::snprintf(buf, sizeof(buf), "%.2fs", p.ns / 1e9);
+    if (p.status == Aborted)
+        return std::string(">") + buf;
+    if (p.status == Matched)
+        return std::string(buf) + "!";
+    return buf;
+}
+
+static std::string  formatSize(size_t bytes)
+{
+    const char  *units[] = { "B", "KB", "MB", "GB" };
+    size_t      unit = 0;
+    char        buf[32];
+
+    while (bytes >= 1000 && bytes % 1000 == 0 && unit < 3)
+    {
+        bytes /= 1000;
+        unit++;
+    }
+    std::snprintf(buf, sizeof(buf), "%lu%s", static_cast<unsigned long>(bytes), units[unit]);
+    return buf;
+}
+
+// exponent of the time between the two largest inputs run
+static std::string  growth(std::vector<point_t> const& points)
+{
+    char    buf[32];
+    size_t  last = 0;
+
+    while (last < points.size() && points[last].status == Done)
+        last++;
+    bool    aborted = last < points.size() && points[last].status == Aborted;
+    if (last < 2)
+        return aborted ? "aborted" : "-";
+    point_t const&  a = points[last - 2];
+    point_t const&  b = points[last - 1];
+    std::snprintf(buf, sizeof(buf), "n^%.1f%s",
+        std::log(b.ns / a.ns) / std::log(double(b.bytes) / a.bytes),
+        aborted ? " then aborted" : "");
+    return buf;
+}
+
+static int      usage()
+{
+    std::fprintf(stderr, "usage: regex_redos [-m bytes] [-t ms] [-o data] [filter]\n"
+        "  -m  largest input (100000000 by default)\n"
+        "  -t  time a run may take, in ms (2000)\n"
+        "  -o  write every point to data\n");
+    return 2;
+}
+
+int main(int ac, char **av)
+{
+    size_t      maxBytes = 100000000;
+    double      timeout = 2e9;
+    std::string output;
+    int         opt;
+
+    while ((opt = getopt(ac, av, "m:t:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm': maxBytes = std::strtoul(optarg, NULL, 10); break;
+        case 't': timeout = std::strtod(optarg, NULL) * 1e6; break;
+        case 'o': output = optarg; break;
+        default: return usage();
+        }
+    }
+    if (ac - optind > 1)
+        return usage();
+    const char  *filter = optind < ac ? av[optind] : "";
+
+    std::ofstream   data;
+    if (!output.empty())
+    {
+        data.open(output.c_str());
+        if (!data)
+        {
+            std::fprintf(stderr, "regex_redos: cannot write %s\n", output.c_str());
+            return 2;
+        }
+        data << "# case engine bytes ns status\n";
+    }
+
+    std::vector<size_t> sizes;
+    for (size_t bytes = 1000; bytes <= maxBytes; bytes *= 10)
+        sizes.push_back(bytes);
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++)
+    {
+        case_t const&   c = cases[i];
+        if (!std::strstr(c.name, filter))
+            continue;
+        std::printf("\n%s: %.60s%s\n%-10s", c.name, c.pattern,
+            std::strlen(c.pattern) > 60 ? "..." : "", "");
+        for (size_t s = 0; s < sizes.size(); s++)
+            std::printf(" %9s", formatSize(sizes[s]).c_str());
+        std::printf("  %s\n", "growth");
+
+        std::vector<std::vector<point_t> >  table(Engines);
+        for (int e = 0; e < Engines; e++)
+        {
+            ft::Regex   *r = supports(c, e) ? compile(c, e) : NULL;
+            bool        stop = !r;
+
+            for (size_t s = 0; s < sizes.size(); s++)
+            {
+                point_t p = { sizes[s], 0, stop ? (r ? Skipped : Unsupported) : Done };
+
+                if (!stop)
+                {
+                    p = run(*r, e, makeInput(c, sizes[s]), timeout);
+                    // the next input is ten times as long
+                    std::vector<point_t> const& prev = table[e];
+                    double  ratio = prev.empty() ? 10 : std::max(10.0, p.ns / prev.back().ns);
+                    stop = p.status != Done || p.ns * ratio > timeout;
+                }
+                table[e].push_back(p);
+                if (data.is_open())
+                    data << c.name << '\t' << engines[e] << '\t' << p.bytes << '\t'
+                        << std::fixed << std::setprecision(0) << p.ns << '\t' << statuses[p.status] << '\n';
+            }
+            delete r;
+
+            std::printf("%-10s", engines[e]);
+            for (size_t s = 0; s < table[e].size(); s++)
+                std::printf(" %9s", format(table[e][s]).c_str());
+            std::printf("  %s\n", growth(table[e]).c_str());
+            std::fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,350 @@
+#include <Regex.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// ft_grep [-cinsh] [-j threads] pattern file...
+// Each file is mapped and cut in chunks ending on a newline, a pool of
+// threads runs the same regex over the chunks and the matching lines are
+// written in the order of the file. With -s the throughput is written to
+// stderr once every file is read
+
+static const size_t     ChunkSize = 1 << 22;
+static const size_t     ChunksPerThread = 4;    // read ahead of the output
+
+struct options_t
+{
+    bool            count;
+    bool            numbers;
+    bool            stats;
+    bool            names;
+    unsigned int    flags;
+    size_t          threads;
+
+    options_t() : count(false), numbers(false), stats(false), names(false),
+        flags(0), threads(0) {}
+};
+
+struct hit_t
+{
+    size_t          line;       // newlines before it in the chunk
+    const char      *begin;
+    const char      *end;       // the newline excluded
+};
+
+struct chunk_t
+{
+    const char          *begin;
+    const char          *end;
+    bool                done;
+    size_t              lines;      // newlines in the chunk, counted with -n
+    std::vector<hit_t>  hits;
+    std::string         error;
+};
+
+// what the threads share while a file is scanned
+struct scan_t
+{
+    ft::Regex const         *regex;
+    options_t const         *options;
+    std::vector<chunk_t>    chunks;
+    size_t                  next;       // first chunk not taken yet
+    size_t                  written;    // chunks written out
+    size_t                  window;
+    pthread_mutex_t         lock;
+    pthread_cond_t          ready;      // a chunk is done
+    pthread_cond_t          room;       // a chunk was written out
+};
+
+// The leftmost match from the current line on gives the next line
+// holding a match, the lines before it hold none; the search then skips
+// to the line after it. A match crossing a newline (\s, [^x]) only
+// keeps its line if the line matches alone
+static void     scanChunk(scan_t const& scan, chunk_t &chunk)
+{
+    ft::Regex::MatchIterator    it(*scan.regex, chunk.begin, chunk.end - chunk.begin);
+    const char                  *line = chunk.begin;
+    const char                  *counted = chunk.begin;
+    size_t                      lines = 0;
+
+    while (it.next())
+    {
+        ft::Regex::match_t const&   m = it.result();
+        const char                  *bol = m.begin();
+
+        while (bol > line && bol[-1] != '\n')
+            bol--;
+        const char  *eol = static_cast<const char *>(std::memchr(m.begin(), '\n',
+            chunk.end - m.begin()));
+        if (!eol)
+            eol = chunk.end;
+        if (m.end() <= eol || scan.regex->test(bol, eol - bol))
+        {
+            if (scan.options->numbers)
+            {
+                lines += std::count(counted, bol, '\n');
+                counted = bol;
+            }
+            hit_t   hit = { lines, bol, eol };
+            chunk.hits.push_back(hit);
+        }
+        line = eol + 1;
+        it.seek(line);
+    }
+    if (scan.options->numbers)
+        lines += std::count(counted, chunk.end, '\n');
+    chunk.lines = lines;
+}
+
+// takes the next chunk and scans it, false once every chunk was taken
+static bool     scanNext(scan_t &scan)
+{
+    pthread_mutex_lock(&scan.lock);
+    while (scan.next < scan.chunks.size() && scan.next >= scan.written + scan.window)
+        pthread_cond_wait(&scan.room, &scan.lock);
+    if (scan.next == scan.chunks.size())
+    {
+        pthread_mutex_unlock(&scan.lock);
+        return false;
+    }
+    chunk_t &chunk = scan.chunks[scan.next++];
+    pthread_mutex_unlock(&scan.lock);
+
+    try
+    {
+        scanChunk(scan, chunk);
+    }
+    catch (std::exception const& e)
+    {
+        chunk.hits.clear();
+        chunk.error = e.what();
+    }
+
+    pthread_mutex_lock(&scan.lock);
+    chunk.done = true;
+    pthread_cond_broadcast(&scan.ready);
+    pthread_mutex_unlock(&scan.lock);
+    return true;
+}
+
+static void     *worker(void *arg)
+{
+    scan_t  &scan = *static_cast<scan_t *>(arg);
+
+    while (scanNext(scan))
+        ;
+    return NULL;
+}
+
+// chunks of about ChunkSize bytes, each one ending after a newline
+static void     splitChunks(const char *data, size_t size, std::vector<chunk_t> &chunks)
+{
+    size_t  pos = 0;
+
+    while (pos < size)
+    {
+        chunk_t     chunk;
+        size_t      end = std::min(pos + ChunkSize, size);
+        const char  *nl = static_cast<const char *>(std::memchr(data + end - 1, '\n',
+            size - end + 1));
+
+        end = nl ? nl - data + 1 : size;
+        chunk.begin = data + pos;
+        chunk.end = data + end;
+        chunk.done = false;
+        chunk.lines = 0;
+        chunks.push_back(chunk);
+        pos = end;
+    }
+}
+
+// returns the number of matching lines, -1 if the file cannot be scanned
+static long long    grepFile(ft::Regex const& regex, options_t const& options,
+    const char *path, unsigned long long &bytes)
+{
+    int         fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        std::fprintf(stderr, "ft_grep: %s: %s\n", path, std::strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    size_t      size = st.st_size;
+    const char  *data = NULL;
+    if (size)
+    {
+        void    *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            std::fprintf(stderr, "ft_grep: %s: %s\n", path, std::strerror(errno));
+            close(fd);
+            return -1;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(map);
+    }
+    close(fd);
+
+    scan_t  scan;
+    scan.regex = &regex;
+    scan.options = &options;
+    splitChunks(data, size, scan.chunks);
+    scan.next = 0;
+    scan.written = 0;
+    scan.window = ChunksPerThread * options.threads;
+    pthread_mutex_init(&scan.lock, NULL);
+    pthread_cond_init(&scan.ready, NULL);
+    pthread_cond_init(&scan.room, NULL);
+
+    std::vector<pthread_t>  threads(std::min(options.threads, scan.chunks.size()));
+    size_t                  started = 0;
+    while (started < threads.size()
+        && pthread_create(&threads[started], NULL, &worker, &scan) == 0)
+        started++;
+    threads.resize(started);
+
+    long long   matches = 0;
+    size_t      line = 1;
+    for (size_t i = 0; i < scan.chunks.size(); i++)
+    {
+        chunk_t &chunk = scan.chunks[i];
+
+        // no thread could be started, the chunks are scanned here
+        if (threads.empty())
+            scanNext(scan);
+        pthread_mutex_lock(&scan.lock);
+        while (!chunk.done)
+            pthread_cond_wait(&scan.ready, &scan.lock);
+        pthread_mutex_unlock(&scan.lock);
+
+        if (!chunk.error.empty())
+        {
+            std::fprintf(stderr, "ft_grep: %s: %s\n", path, chunk.error.c_str());
+            matches = -1;
+        }
+        for (size_t j = 0; j < chunk.hits.size() && matches >= 0 && !options.count; j++)
+        {
+            hit_t const&    hit = chunk.hits[j];
+            if (options.names)
+                std::printf("%s:", path);
+            if (options.numbers)
+                std::printf("%lu:", static_cast<unsigned long>(line + hit.line));
+            std::fwrite(hit.begin, 1, hit.end - hit.begin, stdout);
+            std::putchar('\n');
+        }
+        if (matches >= 0)
+            matches += chunk.hits.size();
+        line += chunk.lines;
+        std::vector<hit_t>().swap(chunk.hits);
+
+        pthread_mutex_lock(&scan.lock);
+        scan.written++;
+        pthread_cond_broadcast(&scan.room);
+        pthread_mutex_unlock(&scan.lock);
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        pthread_join(threads[i], NULL);
+    pthread_cond_destroy(&scan.room);
+    pthread_cond_destroy(&scan.ready);
+    pthread_mutex_destroy(&scan.lock);
+    if (size)
+        munmap(const_cast<char *>(data), size);
+
+    if (options.count && matches >= 0)
+    {
+        if (options.names)
+            std::printf("%s:", path);
+        std::printf("%lld\n", matches);
+    }
+    bytes += size;
+    return matches;
+}
+
+static int      usage()
+{
+    std::fprintf(stderr, "usage: ft_grep [-cinsh] [-j threads] pattern file...\n"
+        "  -c  count the matching lines\n"
+        "  -i  case insensitive\n"
+        "  -n  number the lines\n"
+        "  -s  write the throughput to stderr\n"
+        "  -h  do not prefix the lines with the file name\n"
+        "  -j  threads scanning the chunks (the online cores by default)\n");
+    return 2;
+}
+
+// exits with 0 if a line matched, 1 if none did and 2 on error, like grep
+int main(int ac, char **av)
+{
+    options_t   options;
+    bool        noNames = false;
+    int         opt;
+
+    while ((opt = getopt(ac, av, "cinshj:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': options.count = true; break;
+        case 'i': options.flags |= ft::Regex::iCase; break;
+        case 'n': options.numbers = true; break;
+        case 's': options.stats = true; break;
+        case 'h': noNames = true; break;
+        case 'j': options.threads = std::strtoul(optarg, NULL, 10); break;
+        default: return usage();
+        }
+    }
+    if (ac - optind < 2)
+        return usage();
+    if (!options.threads)
+    {
+        long    cores = sysconf(_SC_NPROCESSORS_ONLN);
+        options.threads = cores > 0 ? cores : 1;
+    }
+    options.names = !noNames && ac - optind > 2;
+
+    ft::Regex   *regex;
+    try
+    {
+        regex = new ft::Regex(av[optind], options.flags);
+    }
+    catch (std::exception const& e)
+    {
+        std::fprintf(stderr, "ft_grep: %s: %s\n", av[optind], e.what());
+        return 2;
+    }
+
+    static char         output[1 << 16];
+    std::setvbuf(stdout, output, _IOFBF, sizeof(output));
+    struct timeval      start, end;
+    unsigned long long  bytes = 0;
+    int                 status = 1;
+    gettimeofday(&start, NULL);
+    for (int i = optind + 1; i < ac; i++)
+    {
+        long long   matches = grepFile(*regex, options, av[i], bytes);
+        if (matches < 0)
+            status = 2;
+        else if (matches > 0 && status == 1)
+            status = 0;
+    }
+    std::fflush(stdout);
+    gettimeofday(&end, NULL);
+    if (options.stats)
+    {
+        double  ms = (end.tv_sec - start.tv_sec) * 1000.0
+            + (end.tv_usec - start.tv_usec) / 1000.0;
+        std::fprintf(stderr, "%llu bytes | %.3fms | %.1f MB/s | %lu threads\n",
+            bytes, ms, ms > 0 ? bytes / 1000.0 / ms : 0.0,
+            static_cast<unsigned long>(options.threads));
+    }
+    delete regex;
+    return status;
+}